@@ -3,35 +3,46 @@
 #include "spinlock.h"
 #include "bcache.h"
 #include "string.h"
+#include "timer.h"
+#include "proc.h"
+#include "blkdev.h"
 
 // 静态缓冲池与哈希桶
 static struct buffer_head bh_pool[BCACHE_NBUFS];
-static char bh_data[BCACHE_NBUFS][BLOCK_SIZE];
+static char bh_data[BCACHE_NBUFS][BLOCK_SIZE] __attribute__((aligned(8)));   // 位图按 64 位字访问
 static struct buffer_head *buckets[BCACHE_NBUCKETS];
 
 // LRU 双向链表的哑元头结点
 static struct buffer_head lru_head;
 static struct spinlock bcache_lock;
 
+// 每设备脏链表的哑元头结点（按首次变脏时间排序，头部最旧）
+static struct buffer_head dirty_head[BCACHE_NDEV];
+static int ndirty = 0;              // 所有脏链表上的块总数
+static int flusher_pid = 0;         // 回写线程 pid（0 表示未启动）
+static int flusher_chan_var = 0;
+static void *flusher_chan = &flusher_chan_var;
+
+// 每设备顺序预读状态
+struct ra_state {
+  uint32 prev;      // 上一次访问的块号
+  uint32 next;      // 下一个尚未预读的块号（已预读窗口的末尾）
+  uint32 marker;    // 触发下一窗口的块号（当前窗口首块）
+  uint32 size;      // 当前窗口大小（块数，0 表示未处于顺序流）
+};
+static struct ra_state ra[BCACHE_NDEV];
+static int ra_pending = 0;          // 已排队未完成的预读块数
+
 // 统计计数器
 uint64 buffer_cache_hits = 0;
 uint64 buffer_cache_misses = 0;
 uint64 disk_read_count = 0;
 uint64 disk_write_count = 0;
-
-// 简单设备 I/O 桩函数（后续应由块设备驱动实现）
-static int block_read(uint dev, uint32 block, void *dst) {
-  // TODO: 接入真实设备读；当前用零填充模拟成功
-  (void)dev; (void)block;
-  memset(dst, 0, BLOCK_SIZE);
-  return 0; // 成功
-}
-
-static int block_write(uint dev, uint32 block, const void *src) {
-  // TODO: 接入真实设备写；当前直接返回成功
-  (void)dev; (void)block; (void)src;
-  return 0; // 成功
-}
+uint64 writeback_batches = 0;
+uint64 writeback_blocks = 0;
+uint64 readahead_blocks = 0;
+uint64 readahead_hits = 0;
+uint64 readahead_waste = 0;
 
 static inline uint hash_index(uint dev, uint32 block) {
   return (dev ^ block) & (BCACHE_NBUCKETS - 1);
@@ -93,6 +104,66 @@ static void hash_insert(struct buffer_head *bh) {
   buckets[idx] = bh;
 }
 
+// 脏链表：新变脏的块追加到尾部，保持按首次变脏时间有序
+static void dirty_list_add(struct buffer_head *bh) {
+  if (bh->dirty_prev) return; // 已在链上，保留最早的变脏时间
+  if (bh->pinned) return;     // 日志固定的块由检查点写回原位
+  if (bh->dev >= BCACHE_NDEV) return; // 超出范围的设备只能同步写回
+  struct buffer_head *head = &dirty_head[bh->dev];
+  bh->dirty_since = timer_ticks();
+  bh->dirty_next = head;
+  bh->dirty_prev = head->dirty_prev;
+  head->dirty_prev->dirty_next = bh;
+  head->dirty_prev = bh;
+  ndirty++;
+}
+
+static void dirty_list_remove(struct buffer_head *bh) {
+  if (!bh->dirty_prev) return;
+  bh->dirty_prev->dirty_next = bh->dirty_next;
+  bh->dirty_next->dirty_prev = bh->dirty_prev;
+  bh->dirty_next = bh->dirty_prev = 0;
+  ndirty--;
+}
+
+// 写完成回调：由块请求层派发完成后调用（提交者持有 bcache_lock）
+static void write_end_io(void *priv, int rc) {
+  struct buffer_head *bh = (struct buffer_head*)priv;
+  disk_write_count++;
+  if (rc < 0) {
+    bh->error = 1;
+    return;
+  }
+  bh->dirty = 0;
+  dirty_list_remove(bh);
+}
+
+// 提交脏块写请求但不派发，便于批量合并（调用者持有 bcache_lock）
+static void writeback_submit(struct buffer_head *bh) {
+  bh->error = 0;
+  blk_submit(bh->dev, BLK_WRITE, bh->block_num, bh->data, write_end_io, bh);
+}
+
+// 写回单个脏块并移出脏链表（调用者持有 bcache_lock）
+static int writeback_locked(struct buffer_head *bh) {
+  writeback_submit(bh);
+  blk_run_queue();
+  return bh->error ? -1 : 0;
+}
+
+// 按块号升序排序（插入排序：批次很小，且输入多已近似有序）
+static void sort_by_block(struct buffer_head **v, int n) {
+  for (int i = 1; i < n; i++) {
+    struct buffer_head *x = v[i];
+    int j = i - 1;
+    while (j >= 0 && v[j]->block_num > x->block_num) {
+      v[j + 1] = v[j];
+      j--;
+    }
+    v[j + 1] = x;
+  }
+}
+
 void bcache_init(void) {
   initlock(&bcache_lock, "bcache");
   lru_init();
@@ -100,7 +171,19 @@ void bcache_init(void) {
   buffer_cache_misses = 0;
   disk_read_count = 0;
   disk_write_count = 0;
+  writeback_batches = 0;
+  writeback_blocks = 0;
+  readahead_blocks = 0;
+  readahead_hits = 0;
+  readahead_waste = 0;
+  ndirty = 0;
+  ra_pending = 0;
+  memset(ra, 0, sizeof(ra));
   for (uint i = 0; i < BCACHE_NBUCKETS; i++) buckets[i] = 0;
+  for (uint d = 0; d < BCACHE_NDEV; d++) {
+    dirty_head[d].dirty_next = &dirty_head[d];
+    dirty_head[d].dirty_prev = &dirty_head[d];
+  }
   for (uint i = 0; i < BCACHE_NBUFS; i++) {
     struct buffer_head *bh = &bh_pool[i];
     bh->dev = 0;
@@ -110,36 +193,146 @@ void bcache_init(void) {
     bh->ref_count = 0;
     bh->valid = 0;
     bh->error = 0;
+    bh->dirty_since = 0;
+    bh->readahead = 0;
+    bh->io_pending = 0;
+    bh->pinned = 0;
     bh->next = 0;
     bh->lru_next = bh->lru_prev = 0;
+    bh->dirty_next = bh->dirty_prev = 0;
     lru_insert_lru(bh);
   }
   printf("bcache: %d bufs, %d buckets, block=%d\n", BCACHE_NBUFS, BCACHE_NBUCKETS, BLOCK_SIZE);
 }
 
 // 选择可替换的缓存块：从 LRU 尾部向前扫描，找 ref_count==0 的块
+// 优先选择干净块，让脏块留给回写线程批量写回；没有干净块时才退化为同步写回
+// 预读 I/O 仍在请求队列中的块与日志固定的块不可替换
 static struct buffer_head *select_victim(void) {
+  struct buffer_head *dirty_victim = 0;
   struct buffer_head *cur = lru_head.lru_prev;
   while (cur != &lru_head) {
-    if (cur->ref_count == 0)
-      return cur;
+    if (cur->ref_count == 0 && !cur->io_pending && !cur->pinned) {
+      if (!cur->dirty)
+        return cur;
+      if (!dirty_victim)
+        dirty_victim = cur;
+    }
     cur = cur->lru_prev;
   }
-  return 0;
+  return dirty_victim;
 }
 
-struct buffer_head* get_block(uint dev, uint block) {
-  acquire(&bcache_lock);
+// 读完成回调：由块请求层派发完成后调用（提交者持有 bcache_lock）
+static void read_end_io(void *priv, int rc) {
+  struct buffer_head *bh = (struct buffer_head*)priv;
+  disk_read_count++;
+  if (bh->io_pending) {
+    bh->io_pending = 0;
+    ra_pending--;
+  }
+  if (rc < 0) {
+    bh->valid = 0;
+    bh->error = 1;
+  } else {
+    bh->valid = 1;
+  }
+}
+
+// 同步读入块数据：提交后立即派发队列（顺带派发已排队的预读）
+static void read_locked(struct buffer_head *bh) {
+  blk_submit(bh->dev, BLK_READ, bh->block_num, bh->data, read_end_io, bh);
+  blk_run_queue();
+}
 
+// 被替换的块若是未被访问过的预读块，计入浪费
+static void retire_victim(struct buffer_head *bh) {
+  if (bh->readahead) readahead_waste++;
+  bh->readahead = 0;
+}
+
+// 为预读窗口 [start, start+n) 预留缓存块并排队，由后台线程异步读入
+// 只占用干净的空闲块，不为投机读取触发同步回写
+static void readahead_queue(uint dev, uint32 start, uint32 n) {
+  int queued = 0;
+  for (uint32 b = start; b < start + n; b++) {
+    if (hash_lookup(dev, b)) continue;
+    struct buffer_head *bh = select_victim();
+    if (!bh || bh->dirty) break;
+    retire_victim(bh);
+    hash_remove(bh);
+    lru_remove(bh);
+    bh->dev = dev;
+    bh->block_num = b;
+    bh->ref_count = 0;
+    bh->valid = 0;
+    bh->error = 0;
+    bh->readahead = 1;
+    bh->io_pending = 1;
+    hash_insert(bh);
+    lru_insert_mru(bh);
+    // 只入队不派发：与相邻预读块合并成多块请求，由后台线程统一派发
+    blk_submit(dev, BLK_READ, b, bh->data, read_end_io, bh);
+    ra_pending++;
+    readahead_blocks++;
+    queued++;
+  }
+  if (queued > 0 && flusher_pid > 0) wakeup(flusher_chan);
+}
+
+// 顺序访问检测：连续块号访问时按倍数扩大窗口，并在读到窗口首块时提前发起下一窗口
+static void readahead_update(uint dev, uint32 block) {
+  if (dev >= BCACHE_NDEV) return;
+  struct ra_state *st = &ra[dev];
+  if (block != st->prev + 1 || st->size == 0) {
+    // 非顺序访问：重置，从下一块重新观察
+    st->size = (block == st->prev + 1) ? BCACHE_RA_MIN : 0;
+    st->next = block + 1;
+    st->marker = block + 1;
+    st->prev = block;
+    if (st->size == 0) return;
+  } else {
+    st->prev = block;
+    if (block < st->marker) return;
+    // 命中触发点：扩大窗口（上限 BCACHE_RA_MAX）
+    st->size = st->size * 2;
+    if (st->size > BCACHE_RA_MAX) st->size = BCACHE_RA_MAX;
+  }
+  if (st->next <= block) st->next = block + 1;
+  readahead_queue(dev, st->next, st->size);
+  st->marker = st->next;
+  st->next += st->size;
+}
+
+// 完成排队的预读：派发请求队列，按电梯顺序读入（调用者持有 bcache_lock）
+static int readahead_complete(void) {
+  if (ra_pending == 0) return 0;
+  int before = ra_pending;
+  blk_run_queue();
+  return before - ra_pending;
+}
+
+// 查找或装载块缓冲并增加引用（调用者持有 bcache_lock）
+// 未命中时只提交读请求而不派发，并置 *need_io，由调用者统一派发请求队列
+// *cold 置 1 表示本次访问来自盘（未命中或命中预读块），只有这类访问参与顺序检测：
+// 文件数据走页缓存后，块缓存中相邻的元数据块（位图、inode 表）被反复命中不应触发预读——
+// 未被访问的预读块停在 MRU 端，而释放的元数据块老化到 LRU 端，被挤出后每个事务都要重读
+static struct buffer_head *lookup_locked(uint dev, uint block, int *need_io, int *cold) {
   // 快速命中
   struct buffer_head *bh = hash_lookup(dev, block);
   if (bh) {
     buffer_cache_hits++;
     bh->ref_count++;
+    if (bh->readahead) {
+      readahead_hits++;
+      bh->readahead = 0;
+      *cold = 1;
+    }
+    // 预读尚未完成：由访问者派发请求队列完成读入
+    if (bh->io_pending) *need_io = 1;
     // 触发 MRU 调整
     lru_remove(bh);
     lru_insert_mru(bh);
-    release(&bcache_lock);
     return bh;
   }
 
@@ -148,24 +341,21 @@ struct buffer_head* get_block(uint dev, uint block) {
   bh = select_victim();
   if (!bh) {
     // 没有可用缓存，返回空
-    release(&bcache_lock);
     printf("bcache: no victim available\n");
     return 0;
   }
 
   // 如需写回则同步
   if (bh->dirty && bh->valid) {
-    int rc = block_write(bh->dev, bh->block_num, bh->data);
-    disk_write_count++;
-    if (rc < 0) {
-      bh->error = 1;
+    if (writeback_locked(bh) < 0) {
       // 写回失败，不安全替换，直接返回失败
-      release(&bcache_lock);
-      printf("bcache: writeback failed dev=%u blk=%u\n", bh->dev, bh->block_num);
+      printf("bcache: writeback failed dev=%d blk=%d\n", bh->dev, bh->block_num);
       return 0;
     }
-    bh->dirty = 0;
   }
+  bh->dirty = 0;
+  dirty_list_remove(bh);
+  retire_victim(bh);
 
   // 从旧哈希桶移除与 LRU 中移除
   hash_remove(bh);
@@ -182,63 +372,398 @@ struct buffer_head* get_block(uint dev, uint block) {
   lru_insert_mru(bh);
 
   // 解锁期间进行 I/O？简单实现：保持锁，避免并发破坏状态
-  int rc = block_read(dev, block, bh->data);
-  disk_read_count++;
-  if (rc < 0) {
-    bh->valid = 0;
-    bh->error = 1;
-  } else {
-    bh->valid = 1;
-  }
+  blk_submit(dev, BLK_READ, block, bh->data, read_end_io, bh);
+  *need_io = 1;
+  *cold = 1;
+  return bh;
+}
 
+struct buffer_head* get_block(uint dev, uint block) {
+  acquire(&bcache_lock);
+  int need_io = 0, cold = 0;
+  struct buffer_head *bh = lookup_locked(dev, block, &need_io, &cold);
+  if (bh) {
+    if (need_io) blk_run_queue();
+    if (cold) readahead_update(dev, block);
+  }
   release(&bcache_lock);
   return bh;
 }
 
-void put_block(struct buffer_head *bh) {
-  if (!bh) return;
-  acquire(&bcache_lock);
+// 释放一个引用（调用者持有 bcache_lock）
+static void put_locked(struct buffer_head *bh) {
   if (bh->ref_count <= 0) {
     printf("bcache: put_block on unreferenced buffer dev=%u blk=%u\n", bh->dev, bh->block_num);
   } else {
     bh->ref_count--;
   }
+  // 调用者直接置位 dirty 的块也纳入脏链表，由回写线程延迟写回（日志固定的块除外）
+  if (bh->dirty && bh->valid) dirty_list_add(bh);
   // 放回 LRU 尾部（老化）
   lru_remove(bh);
   lru_insert_lru(bh);
+}
+
+void put_block(struct buffer_head *bh) {
+  if (!bh) return;
+  acquire(&bcache_lock);
+  put_locked(bh);
+  release(&bcache_lock);
+}
+
+// 批量获取连续块 [start, start+n)：一次加锁、一次查找循环，
+// 所有未命中块一起提交，由请求层合并为一个多块读请求
+int get_blocks(uint dev, uint start, int n, struct buffer_head **bhs) {
+  if (!bhs || n <= 0 || n > BCACHE_NBUFS) return -1;
+  acquire(&bcache_lock);
+  int need_io = 0, cold = 0;
+  for (int i = 0; i < n; i++) {
+    bhs[i] = lookup_locked(dev, start + (uint)i, &need_io, &cold);
+    if (!bhs[i]) {
+      // 缓存不足：派发已提交的读，释放已取得的引用
+      if (need_io) blk_run_queue();
+      for (int j = 0; j < i; j++) {
+        put_locked(bhs[j]);
+        bhs[j] = 0;
+      }
+      release(&bcache_lock);
+      return -1;
+    }
+  }
+  if (need_io) blk_run_queue();
+  release(&bcache_lock);
+  return 0;
+}
+
+void put_blocks(struct buffer_head **bhs, int n) {
+  if (!bhs || n <= 0) return;
+  acquire(&bcache_lock);
+  for (int i = 0; i < n; i++) {
+    if (bhs[i]) put_locked(bhs[i]);
+  }
+  release(&bcache_lock);
+}
+
+// 批量同步写回：所有脏块一起提交后派发一次，相邻块合并为多块写
+// 以下各写回路径都跳过日志固定的块：其原位内容只能由检查点按提交顺序写出
+void sync_blocks(struct buffer_head **bhs, int n) {
+  if (!bhs || n <= 0) return;
+  acquire(&bcache_lock);
+  int submitted = 0;
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = bhs[i];
+    if (bh && bh->dirty && bh->valid && !bh->pinned) {
+      writeback_submit(bh);
+      submitted++;
+    }
+  }
+  if (submitted > 0) blk_run_queue();
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = bhs[i];
+    if (bh && bh->error && bh->dirty && !bh->pinned)
+      printf("bcache: sync write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
+  }
   release(&bcache_lock);
 }
 
 void sync_block(struct buffer_head *bh) {
   if (!bh) return;
   acquire(&bcache_lock);
-  if (bh->dirty && bh->valid) {
-    int rc = block_write(bh->dev, bh->block_num, bh->data);
-    disk_write_count++;
-    if (rc < 0) {
-      bh->error = 1;
-      printf("bcache: sync write failed dev=%u blk=%u\n", bh->dev, bh->block_num);
-    } else {
-      bh->dirty = 0;
+  if (bh->dirty && bh->valid && !bh->pinned) {
+    if (writeback_locked(bh) < 0) {
+      printf("bcache: sync write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
     }
   }
   release(&bcache_lock);
 }
 
+// 标记脏块：不立即写盘，挂入设备脏链表，由回写线程按老化时间批量写回
+void mark_block_dirty(struct buffer_head *bh) {
+  if (!bh) return;
+  acquire(&bcache_lock);
+  bh->dirty = 1;
+  if (bh->pinned) {
+    release(&bcache_lock);
+    return;
+  }
+  if (bh->dev >= BCACHE_NDEV) {
+    // 无脏链表可挂，退化为同步写回
+    if (bh->valid && writeback_locked(bh) < 0)
+      printf("bcache: sync write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
+    release(&bcache_lock);
+    return;
+  }
+  dirty_list_add(bh);
+  int pressure = ndirty > BCACHE_DIRTY_HIGH;
+  release(&bcache_lock);
+  // 脏块过多时不等周期，立即唤醒回写线程
+  if (pressure && flusher_pid > 0) wakeup(flusher_chan);
+}
+
+// 写回设备上所有脏块：只遍历该设备的脏链表，按块号升序写出，代价为 O(dirty)
 void flush_all_blocks(uint dev) {
+  if (dev >= BCACHE_NDEV) return; // 该设备的块从不延迟写回
+  struct buffer_head *batch[BCACHE_NBUFS];
   acquire(&bcache_lock);
-  for (uint i = 0; i < BCACHE_NBUFS; i++) {
-    struct buffer_head *bh = &bh_pool[i];
-    if (bh->dev == dev && bh->dirty && bh->valid) {
-      int rc = block_write(bh->dev, bh->block_num, bh->data);
-      disk_write_count++;
-      if (rc < 0) {
-        bh->error = 1;
-        printf("bcache: flush failed dev=%u blk=%u\n", bh->dev, bh->block_num);
-      } else {
-        bh->dirty = 0;
+  int n = 0;
+  struct buffer_head *head = &dirty_head[dev];
+  for (struct buffer_head *bh = head->dirty_next; bh != head && n < BCACHE_NBUFS; bh = bh->dirty_next) {
+    batch[n++] = bh;
+  }
+  sort_by_block(batch, n);
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = batch[i];
+    if (!bh->valid) {
+      bh->dirty = 0;
+      dirty_list_remove(bh);
+      continue;
+    }
+    if (bh->pinned) {
+      dirty_list_remove(bh);
+      continue;
+    }
+    writeback_submit(bh);
+  }
+  // 一次派发：相邻块合并为多块写请求
+  blk_run_queue();
+  for (int i = 0; i < n; i++) {
+    if (batch[i]->error && batch[i]->dirty && !batch[i]->pinned)
+      printf("bcache: flush failed dev=%d blk=%d\n", batch[i]->dev, batch[i]->block_num);
+  }
+  release(&bcache_lock);
+}
+
+// 写回给定块号中仍在缓存且为脏的块，一次派发；不在缓存中的块已在淘汰时写回
+int sync_block_list(uint dev, const uint32 *blocks, int n) {
+  if (!blocks || n <= 0) return 0;
+  acquire(&bcache_lock);
+  int submitted = 0;
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = hash_lookup(dev, blocks[i]);
+    if (bh && bh->dirty && bh->valid && !bh->io_pending && !bh->pinned) {
+      writeback_submit(bh);
+      submitted++;
+    }
+  }
+  if (submitted > 0) blk_run_queue();
+  int err = 0;
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = hash_lookup(dev, blocks[i]);
+    if (bh && bh->error && bh->dirty && !bh->pinned) {
+      printf("bcache: sync write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
+      err = 1;
+    }
+  }
+  release(&bcache_lock);
+  return err ? -1 : 0;
+}
+
+void pin_block(struct buffer_head *bh) {
+  if (!bh) return;
+  acquire(&bcache_lock);
+  bh->pinned++;
+  // 原位内容改由检查点写出：清除脏位并移出脏链表，任何回写路径都不会提前写到原位
+  bh->dirty = 0;
+  dirty_list_remove(bh);
+  release(&bcache_lock);
+}
+
+int bcache_pinned(uint dev, uint32 block) {
+  acquire(&bcache_lock);
+  struct buffer_head *bh = hash_lookup(dev, block);
+  int pinned = bh && bh->pinned > 0;
+  release(&bcache_lock);
+  return pinned;
+}
+
+void unpin_block_list(uint dev, const uint32 *blocks, int n) {
+  if (!blocks || n <= 0) return;
+  acquire(&bcache_lock);
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = hash_lookup(dev, blocks[i]);
+    if (!bh || bh->pinned <= 0) {
+      printf("bcache: unpin on unpinned block dev=%d blk=%d\n", dev, blocks[i]);
+      continue;
+    }
+    bh->pinned--;
+  }
+  release(&bcache_lock);
+}
+
+// 直接 I/O 完成回调：priv 指向调用者的错误标志
+static void direct_end_io(void *priv, int rc) {
+  if (rc < 0) *(int*)priv = 1;
+}
+
+// 直接 I/O 与缓存保持一致：读时缓存中已有有效副本则直接取用；写后未被引用的副本移出哈希表，
+// 仍被引用的副本同步为新内容；写日志固定的块是调用者的错误
+int bcache_direct_io(uint dev, int op, const uint32 *blocks, char **bufs, int n) {
+  if (!blocks || !bufs || n <= 0) return 0;
+  int err = 0;
+  int submitted = 0;
+  acquire(&bcache_lock);
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = hash_lookup(dev, blocks[i]);
+    if (op == BLK_READ && bh && bh->valid && !bh->io_pending) {
+      memcpy(bufs[i], bh->data, BLOCK_SIZE);
+      continue;
+    }
+    // 日志固定的块只能经日志写入（见 page_write）：直接写会越过未检查点的提交，
+    // 随后移出哈希表还会让日志仍在跟踪的缓存副本与新建的副本并存
+    if (op == BLK_WRITE && bh && bh->pinned) {
+      printf("bcache: direct write to pinned block dev=%d blk=%d\n", dev, blocks[i]);
+      panic("bcache: direct write to pinned block");
+    }
+    blk_submit(dev, op, blocks[i], bufs[i], direct_end_io, &err);
+    submitted++;
+  }
+  if (submitted > 0) blk_run_queue();
+  if (op == BLK_WRITE) {
+    for (int i = 0; i < n; i++) {
+      struct buffer_head *bh = hash_lookup(dev, blocks[i]);
+      if (!bh || bh->io_pending) continue;
+      if (bh->ref_count > 0) {
+        memcpy(bh->data, bufs[i], BLOCK_SIZE);
+        continue;
       }
+      bh->valid = 0;
+      bh->dirty = 0;
+      dirty_list_remove(bh);
+      hash_remove(bh);
     }
   }
   release(&bcache_lock);
+  if (err) printf("bcache: direct %s failed dev=%d n=%d\n", op == BLK_READ ? "read" : "write", dev, n);
+  return err ? -1 : 0;
+}
+
+// 设备卸载或重建时丢弃它的全部缓存块：排队的读先完成，脏块写回后移出哈希表与脏链表，
+// 否则回写线程会把旧块写到之后挂载在同一设备号上的盘，旧的干净块也会被当作新盘的内容
+void bcache_invalidate_dev(uint dev) {
+  struct buffer_head *batch[BCACHE_NBUFS];
+  acquire(&bcache_lock);
+  blk_run_queue();
+  int n = 0, submitted = 0;
+  for (uint i = 0; i < BCACHE_NBUCKETS; i++) {
+    for (struct buffer_head *bh = buckets[i]; bh; bh = bh->next) {
+      if (bh->dev != dev) continue;
+      if (bh->ref_count > 0 || bh->pinned > 0) {
+        printf("bcache: invalidate dev=%d blk=%d ref=%d pinned=%d\n", dev, bh->block_num, bh->ref_count,
+               bh->pinned);
+        panic("bcache: invalidate busy device");
+      }
+      if (bh->dirty && bh->valid) {
+        writeback_submit(bh);
+        submitted++;
+      }
+      batch[n++] = bh;
+    }
+  }
+  if (submitted > 0) blk_run_queue();
+  for (int i = 0; i < n; i++) {
+    struct buffer_head *bh = batch[i];
+    if (bh->error && bh->dirty)
+      printf("bcache: invalidate write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
+    retire_victim(bh);
+    bh->dirty = 0;
+    bh->valid = 0;
+    dirty_list_remove(bh);
+    hash_remove(bh);
+    lru_remove(bh);
+    lru_insert_lru(bh);
+  }
+  if (dev < BCACHE_NDEV) memset(&ra[dev], 0, sizeof(ra[dev]));
+  release(&bcache_lock);
+}
+
+// 把调用者缓冲写到 n 个块的原位，一次派发；缓存中的副本保持不变
+// 日志检查点用：缓存副本可能已含尚未提交的修改，既不能用来写回，也不能被冻结副本覆盖
+int bcache_write_home(uint dev, const uint32 *blocks, char **bufs, int n) {
+  if (!blocks || !bufs || n <= 0) return 0;
+  int err = 0;
+  acquire(&bcache_lock);
+  for (int i = 0; i < n; i++) blk_submit(dev, BLK_WRITE, blocks[i], bufs[i], direct_end_io, &err);
+  blk_run_queue();
+  release(&bcache_lock);
+  if (err) printf("bcache: home write failed dev=%d n=%d\n", dev, n);
+  return err ? -1 : 0;
+}
+
+// 收集一批已老化的脏块（调用者持有 bcache_lock）
+// 各设备脏链表头部最旧，遇到未老化的块即可停止；高水位时忽略老化阈值
+// 日志固定的块由检查点写回，跳过
+static int collect_aged(struct buffer_head **batch, int max) {
+  uint64 now = timer_ticks();
+  int force = ndirty > BCACHE_DIRTY_HIGH;
+  int n = 0;
+  for (uint d = 0; d < BCACHE_NDEV && n < max; d++) {
+    struct buffer_head *head = &dirty_head[d];
+    for (struct buffer_head *bh = head->dirty_next; bh != head && n < max; bh = bh->dirty_next) {
+      if (!force && bh->dirty_since + BCACHE_DIRTY_EXPIRE > now) break;
+      if (bh->pinned) continue;
+      batch[n++] = bh;
+    }
+  }
+  return n;
+}
+
+// 回写线程：周期性写回老化脏块，每批按块号排序以减少寻道；同时完成排队的预读
+static void bcache_flusher(void) {
+  struct buffer_head *batch[BCACHE_FLUSH_BATCH];
+  acquire(&bcache_lock);
+  for (;;) {
+    int nra = readahead_complete();
+    int n = collect_aged(batch, BCACHE_FLUSH_BATCH);
+    if (n == 0) {
+      if (nra > 0) continue;
+      // 无老化脏块，等待时钟周期、高水位或预读请求唤醒
+      sleep(flusher_chan, &bcache_lock);
+      continue;
+    }
+    sort_by_block(batch, n);
+    for (int i = 0; i < n; i++) {
+      struct buffer_head *bh = batch[i];
+      if (!bh->dirty || !bh->valid) {
+        bh->dirty = 0;
+        dirty_list_remove(bh);
+        batch[i] = 0;
+        continue;
+      }
+      writeback_submit(bh);
+    }
+    // 整批一次派发：相邻块在请求层合并为多块写
+    blk_run_queue();
+    for (int i = 0; i < n; i++) {
+      struct buffer_head *bh = batch[i];
+      if (!bh) continue;
+      if (bh->error && bh->dirty) {
+        printf("bcache: flusher write failed dev=%d blk=%d\n", bh->dev, bh->block_num);
+        // 移到链尾稍后重试，避免卡住后续块
+        dirty_list_remove(bh);
+        dirty_list_add(bh);
+      } else {
+        writeback_blocks++;
+      }
+    }
+    writeback_batches++;
+    // 批次之间让出 CPU，避免长时间独占
+    release(&bcache_lock);
+    yield();
+    acquire(&bcache_lock);
+  }
+}
+
+void bcache_flusher_start(void) {
+  if (flusher_pid > 0) return;
+  flusher_pid = create_process_named(bcache_flusher, "bflush");
+  if (flusher_pid < 0) {
+    printf("bcache: cannot start flusher\n");
+    flusher_pid = 0;
+  }
+}
+
+// 时钟中断上下文调用：不取 bcache_lock，仅在有脏块时周期唤醒
+void bcache_on_tick(void) {
+  if (flusher_pid <= 0 || ndirty == 0) return;
+  if ((timer_ticks() % BCACHE_FLUSH_INTERVAL) == 0) wakeup(flusher_chan);
 }
\ No newline at end of file
@@ -8,6 +8,17 @@
 // 缓存的 buffer 数量（固定大小池）
 #define BCACHE_NBUFS    64
 
+// 脏块回写（write-behind）参数
+#define BCACHE_NDEV           4   // 维护脏链表的设备号范围 [0, BCACHE_NDEV)
+#define BCACHE_DIRTY_EXPIRE   5   // 脏块老化阈值（tick）：超过后由回写线程写回
+#define BCACHE_FLUSH_INTERVAL 2   // 回写线程的周期唤醒间隔（tick）
+#define BCACHE_FLUSH_BATCH    16  // 回写线程每批最多写回的块数
+#define BCACHE_DIRTY_HIGH     (BCACHE_NBUFS / 2) // 脏块高水位：超过即立即唤醒回写线程
+
+// 顺序预读参数：窗口从 MIN 起按倍数增长，上限受缓存容量约束
+#define BCACHE_RA_MIN         2
+#define BCACHE_RA_MAX         (BCACHE_NBUFS / 4)
+
 // 块缓冲头：描述缓存的一个块
 struct buffer_head {
   uint   dev;              // 设备号（简单场景一个设备即可）
@@ -17,9 +28,15 @@ struct buffer_head {
   int    ref_count;        // 引用计数：>0 表示正在被使用
   int    valid;            // 数据是否有效（读入成功）
   int    error;            // 最近一次 I/O 是否出错
+  uint64 dirty_since;      // 首次变脏的时刻（timer tick），用于老化回写
+  int    readahead;        // 由预读载入且尚未被访问
+  int    io_pending;       // 预读已排队、数据尚未读入
+  int    pinned;           // 日志固定计数：>0 时不可替换，也不被回写线程提前写回
   struct buffer_head *next;     // 哈希桶链表
   struct buffer_head *lru_next; // LRU 双向链
   struct buffer_head *lru_prev; // LRU 双向链
+  struct buffer_head *dirty_next; // 设备脏链表（按首次变脏时间排序）
+  struct buffer_head *dirty_prev; // 设备脏链表（不在链上时为 0）
 };
 
 // 关键接口
@@ -27,6 +44,30 @@ struct buffer_head* get_block(uint dev, uint block); // 获取（或加载）指
 void put_block(struct buffer_head *bh);              // 释放引用（放回 LRU）
 void sync_block(struct buffer_head *bh);             // 同步单块写回
 void flush_all_blocks(uint dev);                     // 写回设备上所有脏块
+void mark_block_dirty(struct buffer_head *bh);       // 标记脏块（延迟写回）
+
+// 批量接口：一次加锁处理连续块，未命中块合并为一个多块请求
+int get_blocks(uint dev, uint start, int n, struct buffer_head **bhs); // 成功返回 0
+void put_blocks(struct buffer_head **bhs, int n);
+void sync_blocks(struct buffer_head **bhs, int n);   // 批量同步写回
+int sync_block_list(uint dev, const uint32 *blocks, int n); // 按块号写回缓存中的脏块，成功返回 0
+
+// 日志固定：事务记录的块在检查点写回原位前一直留在缓存中，期间不经任何回写路径写到原位
+void pin_block(struct buffer_head *bh);             // 固定计数加一，并清除脏位、移出脏链表
+void unpin_block_list(uint dev, const uint32 *blocks, int n); // 按块号解除固定（每块一次）
+int bcache_pinned(uint dev, uint32 block);          // 该块是否被日志固定（仍在未检查点的事务中）
+// 绕过缓存读写 n 个块（块号可不连续），数据在调用者缓冲区，一次派发；成功返回 0
+// 不得直接写日志固定的块（panic），这类块须经 log_block_write
+int bcache_direct_io(uint dev, int op, const uint32 *blocks, char **bufs, int n);
+// 把调用者缓冲写到 n 个块的原位，不读也不改缓存中的副本；成功返回 0
+int bcache_write_home(uint dev, const uint32 *blocks, char **bufs, int n);
+
+// 丢弃 dev 的全部缓存块（脏块先写回），设备卸载或重建时调用；该设备的块仍被引用或固定时 panic
+void bcache_invalidate_dev(uint dev);
+
+// 后台回写线程
+void bcache_flusher_start(void);                     // 创建回写内核线程
+void bcache_on_tick(void);                           // 时钟中断回调：周期唤醒回写线程
 
 // 初始化缓存（在系统启动时调用）
 void bcache_init(void);
@@ -36,4 +77,9 @@ extern uint64 buffer_cache_hits;
 extern uint64 buffer_cache_misses;
 extern uint64 disk_read_count;
 extern uint64 disk_write_count;
+extern uint64 writeback_batches;   // 回写线程完成的批次数
+extern uint64 writeback_blocks;    // 回写线程写回的块数
+extern uint64 readahead_blocks;    // 预读发起的块数
+extern uint64 readahead_hits;      // 预读块被实际访问的次数
+extern uint64 readahead_waste;     // 预读块未被访问即被淘汰的次数
 #endif
@@ -0,0 +1,179 @@
+#include "types.h"
+#include "printf.h"
+#include "spinlock.h"
+#include "string.h"
+#include "timer.h"
+#include "fs.h"
+#include "blkdev.h"
+#include "ramdisk.h"
+
+static struct blk_request req_pool[BLK_NREQ];
+static struct blk_request *queue;   // 待派发请求，按 (dev, block) 升序
+static struct spinlock blk_lock;
+
+// 电梯位置：上一次派发请求的末尾
+static uint head_dev = 0;
+static uint32 head_block = 0;
+
+// 统计计数器
+uint64 blk_requests = 0;
+uint64 blk_blocks = 0;
+uint64 blk_merges = 0;
+
+// 设备驱动分发：挂载了 RAM 盘的设备号走 RAM 盘驱动，其余仍为桩设备
+// 一次传输 n 个连续块，bufs[i] 为第 i 块的缓冲
+static int block_read(uint dev, uint32 block, uint32 n, char **bufs) {
+  if (ramdisk_present(dev)) return ramdisk_read(dev, block, n, bufs);
+  // TODO: 接入真实设备读；当前用零填充模拟成功
+  for (uint32 i = 0; i < n; i++) memset(bufs[i], 0, BLOCK_SIZE);
+  return 0; // 成功
+}
+
+static int block_write(uint dev, uint32 block, uint32 n, char **bufs) {
+  if (ramdisk_present(dev)) return ramdisk_write(dev, block, n, bufs);
+  // TODO: 接入真实设备写；当前直接返回成功
+  (void)bufs;
+  return 0; // 成功
+}
+
+void blkdev_init(void) {
+  initlock(&blk_lock, "blkdev");
+  memset(req_pool, 0, sizeof(req_pool));
+  queue = 0;
+  head_dev = 0;
+  head_block = 0;
+  blk_requests = 0;
+  blk_blocks = 0;
+  blk_merges = 0;
+}
+
+static inline int pos_less(uint dev_a, uint32 blk_a, uint dev_b, uint32 blk_b) {
+  return dev_a < dev_b || (dev_a == dev_b && blk_a < blk_b);
+}
+
+static struct blk_request *req_alloc(void) {
+  for (int i = 0; i < BLK_NREQ; i++) {
+    if (!req_pool[i].in_use) {
+      req_pool[i].in_use = 1;
+      return &req_pool[i];
+    }
+  }
+  return 0;
+}
+
+// 尝试把单块 I/O 合并进队列中的相邻请求（调用者持有 blk_lock）
+static int try_merge(uint dev, int op, uint32 block, struct blk_seg *s) {
+  for (struct blk_request *r = queue; r; r = r->next) {
+    if (r->dev != dev || r->op != op || r->nblocks >= BLK_MAX_SEGS) continue;
+    if (block == r->block + r->nblocks) {
+      // 后向合并
+      r->seg[r->nblocks++] = *s;
+      return 1;
+    }
+    if (block + 1 == r->block) {
+      // 前向合并：段整体后移一位
+      for (int i = (int)r->nblocks; i > 0; i--) r->seg[i] = r->seg[i - 1];
+      r->seg[0] = *s;
+      r->block = block;
+      r->nblocks++;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void queue_insert(struct blk_request *r) {
+  struct blk_request **pp = &queue;
+  while (*pp && !pos_less(r->dev, r->block, (*pp)->dev, (*pp)->block))
+    pp = &(*pp)->next;
+  r->next = *pp;
+  *pp = r;
+}
+
+void blk_submit(uint dev, int op, uint32 block, char *data, blk_end_io_t end_io, void *priv) {
+  struct blk_seg s = { data, end_io, priv };
+  for (;;) {
+    acquire(&blk_lock);
+    if (try_merge(dev, op, block, &s)) {
+      blk_merges++;
+      release(&blk_lock);
+      return;
+    }
+    struct blk_request *r = req_alloc();
+    if (r) {
+      r->dev = dev;
+      r->op = op;
+      r->block = block;
+      r->nblocks = 1;
+      r->seg[0] = s;
+      r->deadline = timer_ticks() + (op == BLK_READ ? BLK_READ_EXPIRE : BLK_WRITE_EXPIRE);
+      queue_insert(r);
+      release(&blk_lock);
+      return;
+    }
+    // 请求池耗尽：先派发已有请求腾出空间
+    release(&blk_lock);
+    blk_run_queue();
+  }
+}
+
+// 选择下一个派发的请求（调用者持有 blk_lock）
+// 截止时间已过的请求优先（最早到期者先），否则从电梯位置向上取第一个，到顶后回绕（C-LOOK）
+static struct blk_request *pick_next(void) {
+  uint64 now = timer_ticks();
+  struct blk_request *expired = 0;
+  struct blk_request *ahead = 0;
+  for (struct blk_request *r = queue; r; r = r->next) {
+    if (r->deadline <= now && (!expired || r->deadline < expired->deadline))
+      expired = r;
+    if (!ahead && !pos_less(r->dev, r->block, head_dev, head_block))
+      ahead = r;
+  }
+  if (expired) return expired;
+  return ahead ? ahead : queue;
+}
+
+static void queue_remove(struct blk_request *r) {
+  struct blk_request **pp = &queue;
+  while (*pp && *pp != r) pp = &(*pp)->next;
+  if (*pp) *pp = r->next;
+  r->next = 0;
+}
+
+void blk_run_queue(void) {
+  char *bufs[BLK_MAX_SEGS];
+  for (;;) {
+    acquire(&blk_lock);
+    struct blk_request *r = pick_next();
+    if (!r) {
+      release(&blk_lock);
+      return;
+    }
+    queue_remove(r);
+    head_dev = r->dev;
+    head_block = r->block + r->nblocks;
+    blk_requests++;
+    blk_blocks += r->nblocks;
+    release(&blk_lock);
+
+    // 一次驱动调用完成整个多块传输
+    for (uint32 i = 0; i < r->nblocks; i++) bufs[i] = r->seg[i].data;
+    int rc = (r->op == BLK_READ) ? block_read(r->dev, r->block, r->nblocks, bufs)
+                                 : block_write(r->dev, r->block, r->nblocks, bufs);
+    if (rc < 0) {
+      printf("blkdev: %s failed dev=%d blk=%d n=%d\n", r->op == BLK_READ ? "read" : "write",
+             r->dev, r->block, r->nblocks);
+    }
+    for (uint32 i = 0; i < r->nblocks; i++) {
+      if (r->seg[i].end_io) r->seg[i].end_io(r->seg[i].priv, rc);
+    }
+
+    acquire(&blk_lock);
+    r->in_use = 0;
+    release(&blk_lock);
+  }
+}
+
+int blk_queue_pending(void) {
+  return queue != 0;
+}
@@ -0,0 +1,53 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include "types.h"
+
+// 块请求层：位于 bcache 与设备驱动之间
+// 单块 I/O 先进入请求队列，相邻块号合并为多块传输，派发时按截止时间 + 电梯顺序
+
+#define BLK_READ  0
+#define BLK_WRITE 1
+
+#define BLK_NREQ         64   // 请求池大小
+#define BLK_MAX_SEGS     32   // 单个请求最多合并的块数
+#define BLK_READ_EXPIRE  2    // 读请求截止时间（tick），过期优先派发
+#define BLK_WRITE_EXPIRE 10   // 写请求截止时间（tick）
+
+// 完成回调：每个块在派发完成后回调一次，rc<0 表示 I/O 出错
+typedef void (*blk_end_io_t)(void *priv, int rc);
+
+// 请求中的一个块（分散/聚集：各块缓冲不要求连续）
+struct blk_seg {
+  char *data;            // 该块的数据缓冲（BLOCK_SIZE 字节）
+  blk_end_io_t end_io;   // 完成回调
+  void *priv;            // 回调私有参数
+};
+
+// 块 I/O 请求：同一设备上连续的 nblocks 个块
+struct blk_request {
+  uint dev;
+  int op;                      // BLK_READ / BLK_WRITE
+  uint32 block;                // 起始块号
+  uint32 nblocks;              // 已合并的块数
+  uint64 deadline;             // 截止时刻（tick）
+  struct blk_seg seg[BLK_MAX_SEGS];
+  struct blk_request *next;    // 队列链（按设备、块号升序）
+  int in_use;
+};
+
+// 提交单块请求（可能与队列中相邻请求合并），不立即派发
+void blk_submit(uint dev, int op, uint32 block, char *data, blk_end_io_t end_io, void *priv);
+// 派发队列中所有请求：先派发已过期的请求，再按电梯顺序（C-LOOK）派发其余请求
+void blk_run_queue(void);
+// 队列中是否有待派发的请求
+int blk_queue_pending(void);
+
+void blkdev_init(void);
+
+// 统计计数器
+extern uint64 blk_requests;   // 派发到驱动的请求数
+extern uint64 blk_blocks;     // 派发的块总数（blk_blocks / blk_requests 即平均请求大小）
+extern uint64 blk_merges;     // 合并进已有请求的块数
+
+#endif
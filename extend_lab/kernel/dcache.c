@@ -0,0 +1,144 @@
+#include "types.h"
+#include "string.h"
+#include "spinlock.h"
+#include "dcache.h"
+
+struct dentry {
+  int    valid;
+  uint   dev;
+  uint32 parent;             // 父目录 inode 号
+  uint32 inum;               // 0 表示名字不存在
+  uint   namelen;
+  char   name[DCACHE_NAME_LEN];
+  struct dentry *hnext;      // 哈希桶链表
+  struct dentry *lru_next;   // LRU 双向链：头部最近使用，尾部最先替换
+  struct dentry *lru_prev;
+};
+
+static struct dentry dpool[DCACHE_NENTRY];
+static struct dentry *dbuckets[DCACHE_NBUCKETS];
+static struct dentry dlru;   // LRU 哑元头
+static struct spinlock dcache_lock;
+
+// 统计计数器
+uint64 dcache_hits = 0;
+uint64 dcache_neg_hits = 0;
+uint64 dcache_misses = 0;
+
+static uint dhash(uint dev, uint32 parent, const char *name, uint namelen) {
+  uint32 h = 2166136261u ^ dev ^ (parent * 2654435761u);
+  for (uint i = 0; i < namelen; i++) {
+    h ^= (uint8)name[i];
+    h *= 16777619u;
+  }
+  return h & (DCACHE_NBUCKETS - 1);
+}
+
+static void dlru_remove(struct dentry *de) {
+  de->lru_prev->lru_next = de->lru_next;
+  de->lru_next->lru_prev = de->lru_prev;
+}
+
+static void dlru_insert_mru(struct dentry *de) {
+  de->lru_next = dlru.lru_next;
+  de->lru_prev = &dlru;
+  dlru.lru_next->lru_prev = de;
+  dlru.lru_next = de;
+}
+
+static void dlru_insert_lru(struct dentry *de) {
+  de->lru_prev = dlru.lru_prev;
+  de->lru_next = &dlru;
+  dlru.lru_prev->lru_next = de;
+  dlru.lru_prev = de;
+}
+
+static void dhash_remove(struct dentry *de) {
+  struct dentry **pp = &dbuckets[dhash(de->dev, de->parent, de->name, de->namelen)];
+  while (*pp) {
+    if (*pp == de) {
+      *pp = de->hnext;
+      de->hnext = 0;
+      return;
+    }
+    pp = &(*pp)->hnext;
+  }
+}
+
+// 调用者持有 dcache_lock
+static struct dentry *dfind(uint dev, uint32 parent, const char *name, uint namelen) {
+  for (struct dentry *de = dbuckets[dhash(dev, parent, name, namelen)]; de; de = de->hnext) {
+    if (de->dev == dev && de->parent == parent && de->namelen == namelen &&
+        memcmp(de->name, name, namelen) == 0)
+      return de;
+  }
+  return 0;
+}
+
+void dcache_init(void) {
+  initlock(&dcache_lock, "dcache");
+  dlru.lru_next = dlru.lru_prev = &dlru;
+  for (int i = 0; i < DCACHE_NBUCKETS; i++) dbuckets[i] = 0;
+  for (int i = 0; i < DCACHE_NENTRY; i++) {
+    memset(&dpool[i], 0, sizeof(dpool[i]));
+    dlru_insert_mru(&dpool[i]);
+  }
+  dcache_hits = 0;
+  dcache_neg_hits = 0;
+  dcache_misses = 0;
+}
+
+int dcache_lookup(uint dev, uint32 parent, const char *name, uint namelen, uint32 *inum) {
+  if (namelen == 0 || namelen > DCACHE_NAME_LEN) return 0;
+  acquire(&dcache_lock);
+  struct dentry *de = dfind(dev, parent, name, namelen);
+  if (!de) {
+    dcache_misses++;
+    release(&dcache_lock);
+    return 0;
+  }
+  dlru_remove(de);
+  dlru_insert_mru(de);
+  if (de->inum) dcache_hits++;
+  else dcache_neg_hits++;
+  *inum = de->inum;
+  release(&dcache_lock);
+  return 1;
+}
+
+void dcache_add(uint dev, uint32 parent, const char *name, uint namelen, uint32 inum) {
+  if (namelen == 0 || namelen > DCACHE_NAME_LEN) return;
+  acquire(&dcache_lock);
+  struct dentry *de = dfind(dev, parent, name, namelen);
+  if (!de) {
+    // 复用最久未用的项
+    de = dlru.lru_prev;
+    if (de->valid) dhash_remove(de);
+    de->valid = 1;
+    de->dev = dev;
+    de->parent = parent;
+    de->namelen = namelen;
+    memcpy(de->name, name, namelen);
+    uint h = dhash(dev, parent, name, namelen);
+    de->hnext = dbuckets[h];
+    dbuckets[h] = de;
+  }
+  de->inum = inum;
+  dlru_remove(de);
+  dlru_insert_mru(de);
+  release(&dcache_lock);
+}
+
+void dcache_invalidate(uint dev, uint32 parent, const char *name, uint namelen) {
+  if (namelen == 0 || namelen > DCACHE_NAME_LEN) return;
+  acquire(&dcache_lock);
+  struct dentry *de = dfind(dev, parent, name, namelen);
+  if (de) {
+    dhash_remove(de);
+    de->valid = 0;
+    // 空闲项放到尾部，最先被复用
+    dlru_remove(de);
+    dlru_insert_lru(de);
+  }
+  release(&dcache_lock);
+}
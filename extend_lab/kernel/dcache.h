@@ -0,0 +1,26 @@
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "types.h"
+
+// 目录项缓存：(dev, 父目录 inode 号, 名字) -> inode 号，inode 号为 0 表示名字不存在（负缓存）
+// 固定大小池，按 LRU 替换；目录内容改变时由 dir_link/dir_unlink 失效对应项
+#define DCACHE_NENTRY   256   // 缓存的目录项数量
+#define DCACHE_NBUCKETS 128   // 哈希桶数量（2 的幂）
+#define DCACHE_NAME_LEN 32    // 可缓存的最长名字，更长的名字总是查目录块
+
+// 清空缓存（挂载时调用）
+void dcache_init(void);
+// 命中返回 1 并输出 inode 号（0 为负缓存），未命中返回 0
+int dcache_lookup(uint dev, uint32 parent, const char *name, uint namelen, uint32 *inum);
+// 记录查找结果，inum 为 0 时记录名字不存在
+void dcache_add(uint dev, uint32 parent, const char *name, uint namelen, uint32 inum);
+// 删除 (dev, parent, name) 的缓存项
+void dcache_invalidate(uint dev, uint32 parent, const char *name, uint namelen);
+
+// 统计计数器
+extern uint64 dcache_hits;
+extern uint64 dcache_neg_hits;
+extern uint64 dcache_misses;
+
+#endif
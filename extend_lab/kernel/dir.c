@@ -3,7 +3,12 @@
 #include "printf.h"
 #include "fs.h"
 #include "bcache.h"
+#include "blkdev.h"
 #include "dir.h"
+#include "log.h"
+#include "pmm.h"
+#include "dcache.h"
+#include "pagecache.h"
 
 // 读取超级块到 sb_out
 static int read_superblock(int dev, struct superblock *sb_out) {
@@ -16,171 +21,545 @@ static int read_superblock(int dev, struct superblock *sb_out) {
   return 0;
 }
 
-// 从 inode 表加载指定 inode 号到 out
-static int load_inode_by_inum(int dev, const struct superblock *sb, uint32 inum, struct inode *out) {
-  if (!sb || !out) return -1;
-  if (sb->inode_table_start == 0 || sb->inode_table_size == 0) return -1;
-  uint32 ipb = (uint32)(BLOCK_SIZE / sizeof(struct inode));
-  if (ipb == 0) return -1;
-  if (inum >= sb->inode_count) return -1;
-  uint32 blk_index = inum / ipb;
-  uint32 off_index = inum % ipb;
-  if (blk_index >= sb->inode_table_size) return -1;
-  uint32 bno = sb->inode_table_start + blk_index;
-  struct buffer_head *bh = get_block(dev, bno);
-  if (!bh || !bh->valid) { if (bh) put_block(bh); return -1; }
-  char *base = bh->data + (off_index * sizeof(struct inode));
-  memcpy(out, base, sizeof(struct inode));
-  put_block(bh);
-  return 0;
+// 取出块内偏移 *off 处的目录项并前进到下一项，到达块尾或记录损坏时返回 0
+// 空闲项（ino 为 0）同样返回，由调用者跳过
+static struct dirent *dirent_next(char *data, uint *off) {
+  if (*off + sizeof(struct dirent) > BLOCK_SIZE) return 0;
+  struct dirent *de = (struct dirent*)(data + *off);
+  if (de->rec_len < sizeof(struct dirent) || (de->rec_len & 3) || *off + de->rec_len > BLOCK_SIZE ||
+      (de->ino && MYFS_DIRENT_LEN(de->name_len) > de->rec_len)) {
+    // 非法，终止扫描
+    return 0;
+  }
+  *off += de->rec_len;
+  return de;
 }
 
-// 简易根目录获取：读取超级块，并从 inode 表加载根 inode
-static struct inode *get_root_inode(void) {
-  static struct inode g_root_inode;
-  static int g_loaded = 0;
-  if (g_loaded) return &g_root_inode;
+// ===== 单个目录块内的操作 =====
 
-  struct superblock sb;
-  int dev = 0; // 默认设备号 0；可根据挂载点扩展
-  if (read_superblock(dev, &sb) < 0) {
-    printf("dir: read superblock failed\n");
-    return 0;
+// 在块中查找名字，返回块内偏移并输出 inode 号，未找到返回 -1
+static int block_find(char *data, const char *name, uint namelen, uint32 *ino_out) {
+  uint off = 0;
+  struct dirent *de;
+  while ((de = dirent_next(data, &off)) != 0) {
+    if (de->ino == 0) continue; // 空闲空间
+    if (de->name_len == namelen && memcmp(de->name, name, namelen) == 0) {
+      if (ino_out) *ino_out = de->ino;
+      return (int)((char*)de - data);
+    }
+  }
+  return -1;
+}
+
+// 在块内找一处放得下的空闲空间写入目录项：优先复用空闲项，否则切分某项尾部的空余
+// 返回块内偏移，放不下返回 -1
+static int block_add(char *data, const char *name, uint namelen, uint32 inum, uint8 type) {
+  uint need = MYFS_DIRENT_LEN(namelen);
+  uint off = 0;
+  struct dirent *de;
+  while ((de = dirent_next(data, &off)) != 0) {
+    uint used = de->ino ? MYFS_DIRENT_LEN(de->name_len) : 0;
+    if (de->rec_len - used < need) continue;
+    if (used) {
+      struct dirent *nde = (struct dirent*)((char*)de + used);
+      nde->rec_len = (uint16)(de->rec_len - used);
+      de->rec_len = (uint16)used;
+      de = nde;
+    }
+    de->ino = inum;
+    de->name_len = (uint8)namelen;
+    de->type = type;
+    memcpy(de->name, name, namelen);
+    return (int)((char*)de - data);
+  }
+  return -1;
+}
+
+// 删除块内的名字：并入前一项使空闲空间合并，块首项只清零 ino；未找到返回 -1
+static int block_remove(char *data, const char *name, uint namelen) {
+  uint off = 0;
+  struct dirent *prev = 0, *de;
+  while ((de = dirent_next(data, &off)) != 0) {
+    if (de->ino && de->name_len == namelen && memcmp(de->name, name, namelen) == 0) {
+      if (prev) {
+        prev->rec_len = (uint16)(prev->rec_len + de->rec_len);
+      } else {
+        de->ino = 0;
+        de->name_len = 0;
+      }
+      return 0;
+    }
+    prev = de;
+  }
+  return -1;
+}
+
+// 清空为单个覆盖整块的空闲项
+static void block_init(char *data) {
+  memset(data, 0, BLOCK_SIZE);
+  ((struct dirent*)data)->rec_len = BLOCK_SIZE;
+}
+
+// 目录的逻辑块数
+static uint32 dir_nblocks(struct minode *dp) {
+  return dp->d.size / BLOCK_SIZE;
+}
+
+// 在目录末尾追加一个已清零的块，返回逻辑块号并输出磁盘块号，失败返回 -1
+static int dir_append_block(struct minode *dp, uint32 *bno_out) {
+  uint32 lblk = dir_nblocks(dp);
+  uint32 bno = bmap(dp, lblk, 1);
+  if (bno == 0) return -1;
+  dp->d.size = (lblk + 1) * BLOCK_SIZE;
+  iupdate(dp);
+  if (bno_out) *bno_out = bno;
+  return (int)lblk;
+}
+
+// ===== 散列索引（htree） =====
+
+static uint32 dx_hash(const char *name, uint len) {
+  uint32 h = 2166136261u;   // FNV-1a
+  for (uint i = 0; i < len; i++) {
+    h ^= (uint8)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static struct myfs_dx_header *dx_header(char *data, int root) {
+  return (struct myfs_dx_header*)(data + (root ? MYFS_DX_ROOT_OFF : MYFS_DX_NODE_OFF));
+}
+
+static struct myfs_dx_entry *dx_entries(struct myfs_dx_header *h) {
+  return (struct myfs_dx_entry*)(h + 1);
+}
+
+// 最后一个散列下界 <= hash 的索引项（首项视为 0，总能命中）
+static int dx_search(struct myfs_dx_header *h, uint32 hash) {
+  struct myfs_dx_entry *e = dx_entries(h);
+  int lo = 1, hi = h->count - 1, found = 0;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (e[mid].hash <= hash) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
   }
-  if (load_inode_by_inum(dev, &sb, sb.root_inode, &g_root_inode) < 0) {
-    printf("dir: load root inode failed (inum=%u)\n", sb.root_inode);
+  return found;
+}
+
+// 在 pos 处插入索引项（调用者保证有空位）
+static void dx_insert_at(struct myfs_dx_header *h, int pos, uint32 hash, uint32 block) {
+  struct myfs_dx_entry *e = dx_entries(h);
+  for (int i = h->count; i > pos; i--) e[i] = e[i - 1];
+  e[pos].hash = hash;
+  e[pos].block = block;
+  h->count++;
+}
+
+// 从根到叶的查找路径
+struct dx_path {
+  int levels;
+  int root_idx;             // 根中命中的项
+  uint32 node_lblk;         // levels=1 时经过的索引块
+  int node_idx;
+  uint32 leaf_lblk;         // 叶块逻辑号
+};
+
+static struct buffer_head *dir_block(struct minode *dp, uint32 lblk) {
+  uint32 bno = bmap(dp, lblk, 0);
+  if (bno == 0) return 0;
+  struct buffer_head *bh = get_block(dp->dev, bno);
+  if (bh && !bh->valid) {
+    put_block(bh);
     return 0;
   }
-  g_loaded = 1;
-  return &g_root_inode;
+  return bh;
 }
 
-// 解析目录块中的下一个目录项，基于变长 my_dirent 格式
-// 输入：块数据指针 data，偏移 *off（块内偏移）
-// 输出：填充 ino/type/name，返回 1 表示成功读取一项，0 表示到达末尾或数据无效
-static int dirent_next(char *data, uint *off, uint32 *ino_out, uint8 *type_out, char *name_out, uint *name_len_out) {
-  if (*off >= BLOCK_SIZE) return 0;
-  char *p = data + *off;
-  // 读取固定头：ino(4) + type(1) + name_len(2)
-  uint32 ino = *(uint32*)(p);
-  uint8 type = *(uint8*)(p + 4);
-  uint16 name_len = *(uint16*)(p + 5);
-  if (name_len == 0 || name_len > DIR_MAX_NAME) {
-    // 非法，终止扫描
+// 沿索引找到 hash 所在的叶块，索引损坏返回 -1
+static int dx_probe(struct minode *dp, uint32 hash, struct dx_path *path) {
+  struct buffer_head *bh = dir_block(dp, 0);
+  if (!bh) return -1;
+  struct myfs_dx_header *h = dx_header(bh->data, 1);
+  if (h->magic != MYFS_DX_MAGIC || h->count == 0 || h->levels > 1) {
+    put_block(bh);
+    printf("dir: inode %d bad index root\n", dp->inum);
+    return -1;
+  }
+  path->levels = h->levels;
+  path->root_idx = dx_search(h, hash);
+  uint32 next = dx_entries(h)[path->root_idx].block;
+  put_block(bh);
+  if (path->levels == 0) {
+    path->leaf_lblk = next;
     return 0;
   }
-  // 读取名称
-  const char *namep = p + 7;
-  if (name_out) {
-    memcpy(name_out, namep, name_len);
-    name_out[name_len] = '\0';
+  path->node_lblk = next;
+  bh = dir_block(dp, next);
+  if (!bh) return -1;
+  h = dx_header(bh->data, 0);
+  if (h->magic != MYFS_DX_MAGIC || h->count == 0) {
+    put_block(bh);
+    printf("dir: inode %d bad index node %d\n", dp->inum, next);
+    return -1;
   }
-  if (ino_out) *ino_out = ino;
-  if (type_out) *type_out = type;
-  if (name_len_out) *name_len_out = name_len;
+  path->node_idx = dx_search(h, hash);
+  path->leaf_lblk = dx_entries(h)[path->node_idx].block;
+  put_block(bh);
+  return 0;
+}
 
-  // 前进到下一个目录项
-  *off += (uint)(7 + name_len);
-  return 1;
+// 在父索引节点（根或索引块）中紧随 idx 插入一项
+static int dx_parent_insert(struct minode *dp, uint32 lblk, int root, int idx, uint32 hash, uint32 block) {
+  struct buffer_head *bh = dir_block(dp, lblk);
+  if (!bh) return -1;
+  struct myfs_dx_header *h = dx_header(bh->data, root);
+  dx_insert_at(h, idx + 1, hash, block);
+  log_block_write(bh);
+  put_block(bh);
+  return 0;
+}
+
+// 新建索引块，写入 entries 中的 n 项，返回逻辑块号，失败返回 -1
+static int dx_new_node(struct minode *dp, struct myfs_dx_entry *entries, int n) {
+  uint32 bno;
+  int lblk = dir_append_block(dp, &bno);
+  if (lblk < 0) return -1;
+  struct buffer_head *bh = get_block(dp->dev, bno);
+  if (!bh) return -1;
+  block_init(bh->data);   // 覆盖整块的空闲项使线性扫描跳过索引块
+  struct myfs_dx_header *h = dx_header(bh->data, 0);
+  h->magic = MYFS_DX_MAGIC;
+  h->limit = (uint16)MYFS_DX_NODE_LIMIT;
+  h->count = (uint16)n;
+  memcpy(dx_entries(h), entries, n * sizeof(struct myfs_dx_entry));
+  log_block_write(bh);
+  put_block(bh);
+  return lblk;
 }
 
-// 查找目录项：在线性扫描 dp 的直接块中查找名称匹配的项
-struct inode* dir_lookup(struct inode *dp, char *name, uint *poff) {
+// 根已满：全部根项移入新索引块，根变为指向它的单项（levels 0 -> 1）
+static int dx_add_level(struct minode *dp) {
+  struct buffer_head *bh = dir_block(dp, 0);
+  if (!bh) return -1;
+  struct myfs_dx_header *h = dx_header(bh->data, 1);
+  int node = dx_new_node(dp, dx_entries(h), h->count);
+  if (node < 0) {
+    put_block(bh);
+    return -1;
+  }
+  h->count = 0;
+  h->levels = 1;
+  dx_insert_at(h, 0, 0, (uint32)node);
+  log_block_write(bh);
+  put_block(bh);
+  return 0;
+}
+
+// 索引块已满：后一半移入新索引块并在根中登记；根也满时返回 -1
+static int dx_split_node(struct minode *dp, struct dx_path *path) {
+  struct buffer_head *rbh = dir_block(dp, 0);
+  if (!rbh) return -1;
+  int full = dx_header(rbh->data, 1)->count >= dx_header(rbh->data, 1)->limit;
+  put_block(rbh);
+  if (full) {
+    printf("dir: inode %d index full\n", dp->inum);
+    return -1;
+  }
+  struct buffer_head *bh = dir_block(dp, path->node_lblk);
+  if (!bh) return -1;
+  struct myfs_dx_header *h = dx_header(bh->data, 0);
+  int keep = h->count / 2;
+  int node = dx_new_node(dp, dx_entries(h) + keep, h->count - keep);
+  if (node < 0) {
+    put_block(bh);
+    return -1;
+  }
+  uint32 split_hash = dx_entries(h)[keep].hash;
+  h->count = (uint16)keep;
+  log_block_write(bh);
+  put_block(bh);
+  return dx_parent_insert(dp, 0, 1, path->root_idx, split_hash, (uint32)node);
+}
+
+// 叶块分裂用的临时排序项
+struct dx_sort {
+  uint32 hash;
+  uint16 off;
+};
+
+// 叶块已满：按散列排序后把后一半移入新叶块，并在父节点登记新叶块的散列下界
+// 分界点两侧散列值不同，因此查找只需访问一个叶块；整块同一散列值时无法分裂，返回 -1
+static int dx_split_leaf(struct minode *dp, struct dx_path *path) {
+  struct buffer_head *obh = dir_block(dp, path->leaf_lblk);
+  if (!obh) return -1;
+  // 旧块内容与排序数组放在临时页中（内核栈放不下）
+  char *copy = alloc_page();
+  struct dx_sort *ents = alloc_page();
+  if (!copy || !ents) {
+    if (copy) free_page(copy);
+    if (ents) free_page(ents);
+    put_block(obh);
+    return -1;
+  }
+  memcpy(copy, obh->data, BLOCK_SIZE);
+  int n = 0;
+  uint off = 0;
+  struct dirent *de;
+  while ((de = dirent_next(copy, &off)) != 0 && n < (int)(PGSIZE / sizeof(struct dx_sort))) {
+    if (de->ino == 0) continue;
+    ents[n].hash = dx_hash(de->name, de->name_len);
+    ents[n].off = (uint16)((char*)de - copy);
+    n++;
+  }
+  // 插入排序：一个块至多几百项
+  for (int i = 1; i < n; i++) {
+    struct dx_sort t = ents[i];
+    int j = i - 1;
+    while (j >= 0 && ents[j].hash > t.hash) {
+      ents[j + 1] = ents[j];
+      j--;
+    }
+    ents[j + 1] = t;
+  }
+  int mid = n / 2;
+  while (mid < n && mid > 0 && ents[mid].hash == ents[mid - 1].hash) mid++;
+  if (mid == n) {
+    mid = n / 2;
+    while (mid > 0 && ents[mid].hash == ents[mid - 1].hash) mid--;
+  }
+  int ret = -1;
+  uint32 nbno;
+  int nlblk = mid > 0 ? dir_append_block(dp, &nbno) : -1;
+  struct buffer_head *nbh = nlblk >= 0 ? get_block(dp->dev, nbno) : 0;
+  if (nbh) {
+    block_init(obh->data);
+    block_init(nbh->data);
+    for (int i = 0; i < n; i++) {
+      de = (struct dirent*)(copy + ents[i].off);
+      block_add(i < mid ? obh->data : nbh->data, de->name, de->name_len, de->ino, de->type);
+    }
+    log_block_write(obh);
+    log_block_write(nbh);
+    put_block(nbh);
+    if (path->levels == 0)
+      ret = dx_parent_insert(dp, 0, 1, path->root_idx, ents[mid].hash, (uint32)nlblk);
+    else
+      ret = dx_parent_insert(dp, path->node_lblk, 0, path->node_idx, ents[mid].hash, (uint32)nlblk);
+  } else if (mid == 0) {
+    printf("dir: inode %d leaf %d cannot split\n", dp->inum, path->leaf_lblk);
+  }
+  put_block(obh);
+  free_page(copy);
+  free_page(ents);
+  return ret;
+}
+
+// 叶块的父节点已满时先腾出位置：根满则加一层，索引块满则分裂
+static int dx_make_room(struct minode *dp, struct dx_path *path) {
+  if (path->levels == 0) {
+    struct buffer_head *bh = dir_block(dp, 0);
+    if (!bh) return -1;
+    struct myfs_dx_header *h = dx_header(bh->data, 1);
+    int full = h->count >= h->limit;
+    put_block(bh);
+    return full ? dx_add_level(dp) : 0;
+  }
+  struct buffer_head *bh = dir_block(dp, path->node_lblk);
+  if (!bh) return -1;
+  struct myfs_dx_header *h = dx_header(bh->data, 0);
+  int full = h->count >= h->limit;
+  put_block(bh);
+  return full ? dx_split_node(dp, path) : 0;
+}
+
+static int dx_add(struct minode *dp, const char *name, uint namelen, uint32 inum, uint8 type) {
+  uint32 hash = dx_hash(name, namelen);
+  // 每轮至多分裂一次；叶块分裂前可能先要加层或分裂索引块
+  for (int tries = 0; tries < 4; tries++) {
+    struct dx_path path;
+    if (dx_probe(dp, hash, &path) < 0) return -1;
+    struct buffer_head *bh = dir_block(dp, path.leaf_lblk);
+    if (!bh) return -1;
+    if (block_add(bh->data, name, namelen, inum, type) >= 0) {
+      log_block_write(bh);
+      put_block(bh);
+      return 0;
+    }
+    put_block(bh);
+    if (dx_make_room(dp, &path) < 0) return -1;
+    if (dx_probe(dp, hash, &path) < 0) return -1;
+    if (dx_split_leaf(dp, &path) < 0) return -1;
+  }
+  return -1;
+}
+
+static int is_dots(const char *name, uint namelen) {
+  return (namelen == 1 && name[0] == '.') || (namelen == 2 && name[0] == '.' && name[1] == '.');
+}
+
+// 单块线性目录写满时转为索引目录：块 0 只保留 "." 与 ".." 并写入索引根，
+// 其余目录项移入新叶块（逻辑块 1）
+static int dx_make_indexed(struct minode *dp) {
+  struct buffer_head *bh = dir_block(dp, 0);
+  if (!bh) return -1;
+  char *copy = alloc_page();
+  if (!copy) {
+    put_block(bh);
+    return -1;
+  }
+  memcpy(copy, bh->data, BLOCK_SIZE);
+  uint32 lbno;
+  int leaf = dir_append_block(dp, &lbno);
+  struct buffer_head *lbh = leaf >= 0 ? get_block(dp->dev, lbno) : 0;
+  if (!lbh) {
+    free_page(copy);
+    put_block(bh);
+    return -1;
+  }
+  block_init(bh->data);
+  block_init(lbh->data);
+  // "." 与 ".." 位于块首，重新写入后 ".." 覆盖块内其余空间，索引根就在其中
+  uint off = 0;
+  struct dirent *de;
+  while ((de = dirent_next(copy, &off)) != 0) {
+    if (de->ino == 0) continue;
+    block_add(is_dots(de->name, de->name_len) ? bh->data : lbh->data, de->name, de->name_len, de->ino, de->type);
+  }
+  struct myfs_dx_header *h = dx_header(bh->data, 1);
+  h->magic = MYFS_DX_MAGIC;
+  h->limit = (uint16)MYFS_DX_ROOT_LIMIT;
+  h->levels = 0;
+  h->count = 0;
+  dx_insert_at(h, 0, 0, (uint32)leaf);
+  log_block_write(bh);
+  log_block_write(lbh);
+  put_block(lbh);
+  put_block(bh);
+  free_page(copy);
+  dp->d.flags |= MYFS_FL_INDEX;
+  iupdate(dp);
+  return 0;
+}
+
+// ===== 目录操作 =====
+
+// 查找目录项：先查目录项缓存（含不存在的名字），未命中时索引目录经散列直达叶块，
+// 否则线性扫描全部目录块，结果记入缓存
+struct minode* dir_lookup(struct minode *dp, char *name, uint *poff) {
   if (!dp || !name) return 0;
   size_t namelen = strlen(name);
   if (namelen == 0 || namelen > DIR_MAX_NAME) return 0;
 
-  for (uint i = 0; i < MYFS_NDIRECT; i++) {
-    uint32 bno = dp->direct[i];
-    if (bno == 0) continue;
-    struct buffer_head *bh = get_block(0, bno);
-    if (!bh || !bh->valid) { if (bh) put_block(bh); continue; }
-    uint off = 0;
-    while (off < BLOCK_SIZE) {
-      uint32 ino; uint8 type; char nm[DIR_MAX_NAME+1]; uint nlen;
-      uint prev_off = off;
-      if (!dirent_next(bh->data, &off, &ino, &type, nm, &nlen)) break;
-      if (nlen == namelen && memcmp(nm, name, namelen) == 0) {
-        if (poff) *poff = (i * BLOCK_SIZE) + prev_off;
-        // TODO: 通过 inode 号加载实际 inode 结构（需要 inode 表接口）
-        put_block(bh);
-        return 0; // 占位：暂不返回实际 inode
-      }
+  uint32 cached;
+  if (!poff && dcache_lookup(dp->dev, dp->inum, name, namelen, &cached))
+    return cached ? iget(dp->dev, cached) : 0;
+  uint32 first = 0, last = dir_nblocks(dp);
+  if ((dp->d.flags & MYFS_FL_INDEX) && !is_dots(name, namelen)) {
+    struct dx_path path;
+    if (dx_probe(dp, dx_hash(name, namelen), &path) < 0) return 0;
+    first = path.leaf_lblk;
+    last = first + 1;
+  }
+  int complete = 1;   // 读不到的块中可能有该名字，此时不记负缓存
+  for (uint32 i = first; i < last; i++) {
+    struct buffer_head *bh = dir_block(dp, i);
+    if (!bh) {
+      complete = 0;
+      continue;
     }
+    uint32 ino;
+    int off = block_find(bh->data, name, namelen, &ino);
     put_block(bh);
+    if (off >= 0) {
+      if (poff) *poff = (i * BLOCK_SIZE) + (uint)off;
+      dcache_add(dp->dev, dp->inum, name, namelen, ino);
+      // 经 inode 缓存取得目标 inode：命中时不访问块缓存
+      return iget(dp->dev, ino);
+    }
   }
+  if (complete) dcache_add(dp->dev, dp->inum, name, namelen, 0);
   return 0;
 }
 
-// 在目录末尾追加一个目录项（简化：仅使用直接块）
-int dir_link(struct inode *dp, char *name, uint inum) {
+// 添加目录项（调用者持有 ilock 并处于事务中），type 为 inode 的文件类型（my_filetype），记入目录项
+// 线性目录从 dir_hint 起找第一个有空位的块（复用已删除项的空间），都放不下时追加新块；
+// 单块目录写满时转为索引目录
+int dir_link(struct minode *dp, char *name, uint inum, int type) {
   if (!dp || !name) return -1;
   size_t namelen = strlen(name);
   if (namelen == 0 || namelen > DIR_MAX_NAME) return -1;
+  // 缓存中可能有该名字的负缓存项
+  dcache_invalidate(dp->dev, dp->inum, name, namelen);
+  if (dp->d.flags & MYFS_FL_INDEX) return dx_add(dp, name, namelen, inum, (uint8)type);
 
-  // 简化策略：找到第一个可容纳该项的直接块，或使用空块
-  for (uint i = 0; i < MYFS_NDIRECT; i++) {
-    uint32 bno = dp->direct[i];
-    if (bno == 0) {
-      // 需要分配块：此处留空，依赖 myfs_alloc_block
-      return -1;
-    }
-    struct buffer_head *bh = get_block(0, bno);
-    if (!bh || !bh->valid) { if (bh) put_block(bh); continue; }
-    uint off = 0;
-    while (off < BLOCK_SIZE) {
-      // 检查是否越界或可容纳
-      uint need = (uint)(7 + namelen);
-      if (off + need > BLOCK_SIZE) break;
-      // 写入目录项
-      char *p = bh->data + off;
-      *(uint32*)p = (uint32)inum;
-      *(uint8*)(p + 4) = (uint8)MYFT_REG; // 默认为普通文件；调用者应按需传递或修改
-      *(uint16*)(p + 5) = (uint16)namelen;
-      memcpy(p + 7, name, namelen);
-      bh->dirty = 1;
-      sync_block(bh);
+  uint32 n = dir_nblocks(dp);
+  for (uint32 i = dp->dir_hint; i < n; i++) {
+    struct buffer_head *bh = dir_block(dp, i);
+    if (!bh) continue;
+    if (block_add(bh->data, name, namelen, inum, (uint8)type) >= 0) {
+      log_block_write(bh);
       put_block(bh);
       return 0;
     }
     put_block(bh);
+    // 前面的块都已写满，下次从后一块开始找
+    if (i == dp->dir_hint) dp->dir_hint = i + 1;
   }
-  return -1;
+  if (n == 1) {
+    if (dx_make_indexed(dp) < 0) return -1;
+    return dx_add(dp, name, namelen, inum, (uint8)type);
+  }
+  // 现有块已满：分配新块，目录大小按块增长
+  uint32 bno;
+  if (dir_append_block(dp, &bno) < 0) return -1;
+  struct buffer_head *bh = get_block(dp->dev, bno);
+  if (!bh) return -1;
+  block_init(bh->data);
+  int r = block_add(bh->data, name, namelen, inum, (uint8)type);
+  log_block_write(bh);
+  put_block(bh);
+  return r < 0 ? -1 : 0;
 }
 
-// 线性扫描，找到名称并通过零化 ino 标记删除（简化删除）
-int dir_unlink(struct inode *dp, char *name) {
+// 删除目录项：空间并入同块前一项，之后的 dir_link 可复用；索引目录只访问散列所在的叶块
+// （调用者持有 ilock 并处于事务中）
+int dir_unlink(struct minode *dp, char *name) {
   if (!dp || !name) return -1;
   size_t namelen = strlen(name);
   if (namelen == 0 || namelen > DIR_MAX_NAME) return -1;
+  dcache_invalidate(dp->dev, dp->inum, name, namelen);
 
-  for (uint i = 0; i < MYFS_NDIRECT; i++) {
-    uint32 bno = dp->direct[i];
-    if (bno == 0) continue;
-    struct buffer_head *bh = get_block(0, bno);
-    if (!bh || !bh->valid) { if (bh) put_block(bh); continue; }
-    uint off = 0;
-    while (off < BLOCK_SIZE) {
-      uint32 ino; uint8 type; char nm[DIR_MAX_NAME+1]; uint nlen; uint prev_off = off;
-      if (!dirent_next(bh->data, &off, &ino, &type, nm, &nlen)) break;
-      if (nlen == namelen && memcmp(nm, name, namelen) == 0) {
-        char *p = bh->data + prev_off;
-        *(uint32*)p = 0; // 标记为空
-        bh->dirty = 1;
-        sync_block(bh);
-        put_block(bh);
-        return 0;
-      }
+  uint32 first = 0, last = dir_nblocks(dp);
+  if ((dp->d.flags & MYFS_FL_INDEX) && !is_dots(name, namelen)) {
+    struct dx_path path;
+    if (dx_probe(dp, dx_hash(name, namelen), &path) < 0) return -1;
+    first = path.leaf_lblk;
+    last = first + 1;
+  }
+  for (uint32 i = first; i < last; i++) {
+    struct buffer_head *bh = dir_block(dp, i);
+    if (!bh) continue;
+    if (block_remove(bh->data, name, namelen) == 0) {
+      log_block_write(bh);
+      put_block(bh);
+      if (i < dp->dir_hint) dp->dir_hint = i;
+      return 0;
     }
     put_block(bh);
   }
   return -1;
 }
 
-// 路径解析：从根目录开始，逐段查找
-struct inode* path_walk(char *path) {
+// 路径解析：从根目录开始，逐段查找；逐级加锁当前目录，查找后释放
+// 各段经 dir_lookup 查目录项缓存，热路径只访问哈希表与 inode 缓存
+struct minode* path_walk(char *path) {
   if (!path || path[0] == '\0') return 0;
-  struct inode *ip = get_root_inode();
+  struct minode *ip = iroot();
   if (!ip) return 0;
 
   char seg[DIR_MAX_NAME+1];
@@ -197,20 +576,27 @@ struct inode* path_walk(char *path) {
     seg[s] = '\0';
     // 处理 '.' 与 '..'（简化：忽略，留作扩展）
     // 正常查找
-    ip = dir_lookup(ip, seg, 0);
-    if (!ip) return 0;
+    ilock(ip);
+    if (MYFS_TYPE(ip->d.mode) != MYFT_DIR) {
+      iunlockput(ip);
+      return 0;
+    }
+    struct minode *next = dir_lookup(ip, seg, 0);
+    iunlockput(ip);
+    if (!next) return 0;
+    ip = next;
   }
   return ip;
 }
 
 // 返回父目录 inode，并输出最后一段名字到 name
-struct inode* path_parent(char *path, char *name) {
+struct minode* path_parent(char *path, char *name) {
   if (!path || !name) return 0;
-  struct inode *ip = get_root_inode();
-  if (!ip) return 0;
+  struct minode *parent = iroot();
+  if (!parent) return 0;
 
   char seg[DIR_MAX_NAME+1];
-  uint idx = 0; struct inode *parent = ip;
+  uint idx = 0;
   while (path[idx] != '\0') {
     while (path[idx] == '/') idx++;
     if (path[idx] == '\0') break;
@@ -228,9 +614,17 @@ struct inode* path_parent(char *path, char *name) {
       return parent;
     }
     // 继续下降
-    parent = dir_lookup(parent, seg, 0);
-    if (!parent) return 0;
+    ilock(parent);
+    if (MYFS_TYPE(parent->d.mode) != MYFT_DIR) {
+      iunlockput(parent);
+      return 0;
+    }
+    struct minode *next = dir_lookup(parent, seg, 0);
+    iunlockput(parent);
+    if (!next) return 0;
+    parent = next;
   }
+  iput(parent);
   return 0;
 }
 
@@ -238,7 +632,7 @@ struct inode* path_parent(char *path, char *name) {
 void debug_filesystem_state(void) {
   printf("=== Filesystem Debug Info ===\n");
   struct superblock sb;
-  if (read_superblock(0, &sb) < 0) {
+  if (fs_superblock(&sb) < 0 && read_superblock(0, &sb) < 0) {
     printf("Superblock read failed or magic mismatch\n");
     return;
   }
@@ -247,17 +641,30 @@ void debug_filesystem_state(void) {
   printf("Free inodes: %u\n", sb.free_inode_count);
   printf("Buffer cache hits: %llu\n", (unsigned long long)buffer_cache_hits);
   printf("Buffer cache misses: %llu\n", (unsigned long long)buffer_cache_misses);
+  printf("Readahead blocks: %d hits: %d waste: %d\n",
+         (int)readahead_blocks, (int)readahead_hits, (int)readahead_waste);
+  printf("Block allocs: %d avg %d cycles, inode allocs: %d avg %d cycles, bitmap words scanned: %d\n",
+         (int)fs_balloc_count, fs_balloc_count ? (int)(fs_balloc_cycles / fs_balloc_count) : 0,
+         (int)fs_ialloc_count, fs_ialloc_count ? (int)(fs_ialloc_cycles / fs_ialloc_count) : 0,
+         (int)fs_bitmap_words);
+  printf("Dentry cache hits: %d negative hits: %d misses: %d\n",
+         (int)dcache_hits, (int)dcache_neg_hits, (int)dcache_misses);
+  printf("Page cache hits: %d misses: %d evictions: %d\n",
+         (int)pcache_hits, (int)pcache_misses, (int)pcache_evictions);
+  printf("Delayed allocation: %d runs, %d blocks, %d dirty pages\n",
+         (int)fs_delalloc_runs, (int)fs_delalloc_blocks, pcache_ndirty);
 }
 
 void debug_inode_usage(void) {
   printf("=== Inode Usage ===\n");
-  // 说明：当前项目尚未实现 inode 缓存(icache)与 NINODE，无法逐项打印。
-  // 一旦引入 inode 缓存结构，可在此遍历并输出引用计数等信息。
-  printf("inode 缓存未实现，暂无法追踪。\n");
+  icache_dump();
 }
 
 void debug_disk_io(void) {
   printf("=== Disk I/O Statistics ===\n");
   printf("Disk reads: %p\n", (void*)disk_read_count);
   printf("Disk writes: %p\n", (void*)disk_write_count);
+  printf("Writeback batches: %p blocks: %p\n", (void*)writeback_batches, (void*)writeback_blocks);
+  printf("Block requests: %d merged: %d avg size: %d blocks\n",
+         (int)blk_requests, (int)blk_merges, blk_requests ? (int)(blk_blocks / blk_requests) : 0);
 }
\ No newline at end of file
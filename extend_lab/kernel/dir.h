@@ -5,18 +5,21 @@
 #include "string.h"
 #include "fs.h"
 #include "bcache.h"
+#include "inode.h"
 
 // 文件名最大长度建议（目录项中使用变长，解析时限制）
 #define DIR_MAX_NAME 255
 
-// 目录操作接口（与任务描述一致，使用 struct inode*）
-struct inode* dir_lookup(struct inode *dp, char *name, uint *poff);
-int dir_link(struct inode *dp, char *name, uint inum);
-int dir_unlink(struct inode *dp, char *name);
+// 目录操作接口：dp 为 inode 缓存中的目录（调用者持有 ilock）
+// dir_lookup 返回已引用、未加锁的 inode
+struct minode* dir_lookup(struct minode *dp, char *name, uint *poff);
+// type 为 inode 的文件类型（my_filetype），与 mkfs/fs_format 写入的目录项一致
+int dir_link(struct minode *dp, char *name, uint inum, int type);
+int dir_unlink(struct minode *dp, char *name);
 
-// 路径解析
-struct inode* path_walk(char *path);
-struct inode* path_parent(char *path, char *name);
+// 路径解析：返回已引用、未加锁的 inode，用完后 iput
+struct minode* path_walk(char *path);
+struct minode* path_parent(char *path, char *name);
 
 // 调试接口
 void debug_filesystem_state(void);
@@ -0,0 +1,332 @@
+#include "types.h"
+#include "string.h"
+#include "printf.h"
+#include "fs.h"
+#include "bcache.h"
+#include "log.h"
+#include "inode.h"
+#include "extent.h"
+
+static struct myfs_extent_header *ext_root(struct minode *ip) {
+  return (struct myfs_extent_header*)ip->d.i_block;
+}
+
+static struct myfs_extent *ext_entries(struct myfs_extent_header *h) {
+  return (struct myfs_extent*)(h + 1);
+}
+
+// 二分查找最后一个 lblk <= bn 的项，不存在返回 -1
+static int ext_search(struct myfs_extent *e, int n, uint32 bn) {
+  int lo = 0, hi = n - 1, found = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (e[mid].lblk <= bn) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+// 在有序数组的 pos 处插入一项（调用者保证有空位）
+static void ext_insert_at(struct myfs_extent_header *h, int pos, uint32 lblk, uint32 pblk, uint32 len) {
+  struct myfs_extent *e = ext_entries(h);
+  for (int i = h->entries; i > pos; i--) e[i] = e[i - 1];
+  e[pos].lblk = lblk;
+  e[pos].pblk = pblk;
+  e[pos].len = len;
+  h->entries++;
+}
+
+void ext_init(struct minode *ip) {
+  memset(ip->d.i_block, 0, sizeof(ip->d.i_block));
+  struct myfs_extent_header *h = ext_root(ip);
+  h->magic = MYFS_EXT_MAGIC;
+  h->entries = 0;
+  h->max = (uint16)MYFS_EXT_INODE_MAX;
+  h->depth = 0;
+  ip->d.flags |= MYFS_FL_EXTENTS;
+}
+
+// 在一个 extent 节点中查找 bn
+static uint32 node_map(struct myfs_extent_header *h, uint32 bn, uint32 *run) {
+  struct myfs_extent *e = ext_entries(h);
+  int i = ext_search(e, h->entries, bn);
+  if (i >= 0 && bn < e[i].lblk + e[i].len) {
+    *run = e[i].lblk + e[i].len - bn;
+    return e[i].pblk + (bn - e[i].lblk);
+  }
+  // 空洞：延伸到下一个 extent 之前
+  *run = (i + 1 < h->entries) ? e[i + 1].lblk - bn : 1;
+  return 0;
+}
+
+// 读入索引节点 h 第 i 项指向的下一层节点（已引用），读取失败或不是 h 的下一层时返回 0
+static struct buffer_head *ext_child(struct minode *ip, struct myfs_extent_header *h, int i) {
+  struct buffer_head *bh = get_block(ip->dev, ext_entries(h)[i].pblk);
+  if (!bh) return 0;
+  struct myfs_extent_header *ch = (struct myfs_extent_header*)bh->data;
+  if (!bh->valid || ch->magic != MYFS_EXT_MAGIC || ch->depth + 1 != h->depth) {
+    put_block(bh);
+    return 0;
+  }
+  return bh;
+}
+
+// 从根到叶的路径：第 0 层是 inode 中的根，其余各层是已引用的树块
+struct ext_path {
+  struct myfs_extent_header *h;  // 本层节点
+  struct buffer_head *bh;        // 节点所在的块，根为 0
+  int idx;                       // 索引节点中选中的项
+};
+
+static void path_release(struct ext_path *path, int n) {
+  for (int k = 1; k < n; k++) put_block(path[k].bh);
+}
+
+// 自根向下找到 bn 所在的叶节点，返回路径层数（叶为 path[n-1]），读块失败返回 -1
+// bn 在某层第一个索引项之前时走最左的子树
+static int ext_walk(struct minode *ip, uint32 bn, struct ext_path *path) {
+  int n = 0;
+  path[0].h = ext_root(ip);
+  path[0].bh = 0;
+  while (path[n].h->depth > 0) {
+    struct myfs_extent_header *h = path[n].h;
+    int i = ext_search(ext_entries(h), h->entries, bn);
+    if (i < 0) i = 0;
+    path[n].idx = i;
+    struct buffer_head *bh = (n < MYFS_EXT_MAX_DEPTH && h->entries > 0) ? ext_child(ip, h, i) : 0;
+    if (!bh) {
+      path_release(path, n + 1);
+      return -1;
+    }
+    n++;
+    path[n].h = (struct myfs_extent_header*)bh->data;
+    path[n].bh = bh;
+  }
+  return n + 1;
+}
+
+uint32 ext_map(struct minode *ip, uint32 bn, uint32 *run) {
+  struct myfs_extent_header *h = ext_root(ip);
+  *run = 1;
+  if (h->magic != MYFS_EXT_MAGIC) return 0;
+  if (h->depth == 0) return node_map(h, bn, run);
+  struct ext_path path[MYFS_EXT_MAX_DEPTH + 1];
+  int n = ext_walk(ip, bn, path);
+  if (n < 0) return 0;
+  uint32 b = node_map(path[n - 1].h, bn, run);
+  // 空洞不越过各层下一个子树的起点
+  for (int k = 0; b == 0 && k < n - 1; k++) {
+    struct myfs_extent_header *ih = path[k].h;
+    int next = path[k].idx + 1;
+    if (next < ih->entries && bn + *run > ext_entries(ih)[next].lblk) *run = ext_entries(ih)[next].lblk - bn;
+  }
+  path_release(path, n);
+  return b;
+}
+
+// 把 bn -> b 记入节点 h：能紧接前一个 extent 时延长它，否则插入新项
+// 节点已满返回 -1（调用者负责分裂）
+static int node_add(struct myfs_extent_header *h, uint32 bn, uint32 b) {
+  struct myfs_extent *e = ext_entries(h);
+  int i = ext_search(e, h->entries, bn);
+  if (i >= 0 && e[i].lblk + e[i].len == bn && e[i].pblk + e[i].len == b && e[i].len < MYFS_EXT_MAX_LEN) {
+    e[i].len++;
+    return 0;
+  }
+  if (h->entries >= h->max) return -1;
+  ext_insert_at(h, i + 1, bn, b, 1);
+  return 0;
+}
+
+// 为 bn 选择分配目标：紧接前一个 extent 末尾（按逻辑偏移外推），无前驱时交给分配器
+static uint32 node_goal(struct myfs_extent_header *h, uint32 bn) {
+  struct myfs_extent *e = ext_entries(h);
+  int i = ext_search(e, h->entries, bn);
+  if (i < 0) return 0;
+  return e[i].pblk + (bn - e[i].lblk);
+}
+
+// 分配一个树块并写入头部（块已被引用），失败时不留下已分配的块
+static struct buffer_head *node_alloc(struct minode *ip, uint32 goal, uint16 depth) {
+  uint32 nb = balloc_near(goal);
+  if (!nb) return 0;
+  struct buffer_head *bh = get_block(ip->dev, nb);
+  if (!bh) {
+    bfree(nb);
+    return 0;
+  }
+  ip->d.blocks++;
+  struct myfs_extent_header *h = (struct myfs_extent_header*)bh->data;
+  h->magic = MYFS_EXT_MAGIC;
+  h->entries = 0;
+  h->max = (uint16)MYFS_EXT_LEAF_MAX;
+  h->depth = depth;
+  return bh;
+}
+
+// 根节点已满：把根的全部项移入新块，根变为指向它的单项索引，树增高一层
+static int ext_grow(struct minode *ip) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->depth >= MYFS_EXT_MAX_DEPTH) {
+    printf("ext: inode %d extent tree full (depth %d)\n", ip->inum, h->depth);
+    return -1;
+  }
+  struct buffer_head *bh = node_alloc(ip, h->entries ? ext_entries(h)[0].pblk : 0, h->depth);
+  if (!bh) return -1;
+  struct myfs_extent_header *nh = (struct myfs_extent_header*)bh->data;
+  nh->entries = h->entries;
+  memcpy(ext_entries(nh), ext_entries(h), h->entries * sizeof(struct myfs_extent));
+  uint32 nb = bh->block_num;
+  log_block_write(bh);
+  put_block(bh);
+  h->depth++;
+  h->entries = 0;
+  ext_insert_at(h, 0, 0, nb, 0);
+  return 0;
+}
+
+// 树块 path[k] 已满且父节点有空位：后一半移入新块，并在父节点中插入其索引
+static int ext_split(struct minode *ip, struct ext_path *path, int k) {
+  struct ext_path *parent = &path[k - 1];
+  struct myfs_extent_header *oh = path[k].h;
+  struct buffer_head *nbh = node_alloc(ip, path[k].bh->block_num + 1, oh->depth);
+  if (!nbh) return -1;
+  struct myfs_extent_header *nh = (struct myfs_extent_header*)nbh->data;
+  int keep = oh->entries / 2;
+  nh->entries = (uint16)(oh->entries - keep);
+  memcpy(ext_entries(nh), ext_entries(oh) + keep, nh->entries * sizeof(struct myfs_extent));
+  oh->entries = (uint16)keep;
+  uint32 first = ext_entries(nh)[0].lblk;
+  uint32 nb = nbh->block_num;
+  log_block_write(path[k].bh);
+  log_block_write(nbh);
+  put_block(nbh);
+  ext_insert_at(parent->h, parent->idx + 1, first, nb, 0);
+  if (parent->bh) log_block_write(parent->bh);
+  return 0;
+}
+
+// 为已满的节点 path[k] 腾出空间，每次只做一处结构修改，调用者重新查找路径后重试：
+// 根已满时增高；父节点有空位时分裂该节点；父节点也满时先为父节点腾空间
+static int ext_make_room(struct minode *ip, struct ext_path *path, int k) {
+  if (k == 0) return ext_grow(ip);
+  if (path[k - 1].h->entries >= path[k - 1].h->max) return ext_make_room(ip, path, k - 1);
+  return ext_split(ip, path, k);
+}
+
+int ext_insert_maxblocks(struct minode *ip) {
+  struct myfs_extent_header *h = ext_root(ip);
+  int depth = h->magic == MYFS_EXT_MAGIC ? h->depth : 0;
+  return 3 * depth + 2;
+}
+
+uint32 ext_goal(struct minode *ip, uint32 bn) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->magic != MYFS_EXT_MAGIC || h->entries == 0) return 0;
+  if (h->depth == 0) return node_goal(h, bn);
+  struct ext_path path[MYFS_EXT_MAX_DEPTH + 1];
+  int n = ext_walk(ip, bn, path);
+  if (n < 0) return 0;
+  uint32 goal = node_goal(path[n - 1].h, bn);
+  path_release(path, n);
+  return goal;
+}
+
+int ext_insert(struct minode *ip, uint32 bn, uint32 b) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->magic != MYFS_EXT_MAGIC) ext_init(ip);
+  for (;;) {
+    struct ext_path path[MYFS_EXT_MAX_DEPTH + 1];
+    int n = ext_walk(ip, bn, path);
+    if (n < 0) return -1;
+    struct ext_path *leaf = &path[n - 1];
+    if (node_add(leaf->h, bn, b) == 0) {
+      if (leaf->bh) log_block_write(leaf->bh);
+      path_release(path, n);
+      ip->d.blocks++;
+      return 0;
+    }
+    int r = ext_make_room(ip, path, n - 1);
+    path_release(path, n);
+    if (r < 0) return -1;
+  }
+}
+
+uint32 ext_alloc(struct minode *ip, uint32 bn) {
+  uint32 b = balloc_data(ext_goal(ip, bn));
+  if (!b) return 0;
+  if (ext_insert(ip, bn, b) < 0) {
+    bfree(b);
+    return 0;
+  }
+  return b;
+}
+
+// 释放节点 h 之下的全部数据块与树块（h 自身所在的块由调用者释放）
+static void free_node(struct minode *ip, struct myfs_extent_header *h) {
+  struct myfs_extent *e = ext_entries(h);
+  for (int i = 0; i < h->entries; i++) {
+    if (h->depth == 0) {
+      for (uint32 k = 0; k < e[i].len; k++) bfree(e[i].pblk + k);
+      continue;
+    }
+    struct buffer_head *bh = ext_child(ip, h, i);
+    if (bh) {
+      free_node(ip, (struct myfs_extent_header*)bh->data);
+      put_block(bh);
+    }
+    bfree(e[i].pblk);
+  }
+}
+
+void ext_truncate(struct minode *ip) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->magic == MYFS_EXT_MAGIC) free_node(ip, h);
+  ext_init(ip);
+}
+
+static uint32 span_groups(struct minode *ip, struct myfs_extent_header *h, uint32 group_bits) {
+  struct myfs_extent *e = ext_entries(h);
+  uint32 n = 0;
+  for (int i = 0; i < h->entries; i++) {
+    if (h->depth == 0) {
+      if (e[i].len > 0) n += (e[i].pblk + e[i].len - 1) / group_bits - e[i].pblk / group_bits + 1;
+      continue;
+    }
+    struct buffer_head *bh = ext_child(ip, h, i);
+    if (bh) {
+      n += span_groups(ip, (struct myfs_extent_header*)bh->data, group_bits);
+      put_block(bh);
+    }
+    n++;   // 树块本身
+  }
+  return n;
+}
+
+uint32 ext_span_groups(struct minode *ip, uint32 group_bits) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->magic != MYFS_EXT_MAGIC) return 0;
+  return span_groups(ip, h, group_bits);
+}
+
+static int count_node(struct minode *ip, struct myfs_extent_header *h) {
+  if (h->depth == 0) return h->entries;
+  int n = 0;
+  for (int i = 0; i < h->entries; i++) {
+    struct buffer_head *bh = ext_child(ip, h, i);
+    if (!bh) continue;
+    n += count_node(ip, (struct myfs_extent_header*)bh->data);
+    put_block(bh);
+  }
+  return n;
+}
+
+int ext_count(struct minode *ip) {
+  struct myfs_extent_header *h = ext_root(ip);
+  if (h->magic != MYFS_EXT_MAGIC) return 0;
+  return count_node(ip, h);
+}
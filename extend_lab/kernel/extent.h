@@ -0,0 +1,29 @@
+#ifndef EXTENT_H
+#define EXTENT_H
+
+#include "types.h"
+#include "inode.h"
+
+// extent 块映射：inode 置 MYFS_FL_EXTENTS 时由 bmap/itrunc 调用
+// 修改类操作需处于事务中，调用者持有 ilock
+
+// 初始化空的 extent 树并置位 MYFS_FL_EXTENTS
+void ext_init(struct minode *ip);
+// 逻辑块 bn 对应的物理块，空洞返回 0；*run 为从 bn 起物理连续（或空洞）的块数
+uint32 ext_map(struct minode *ip, uint32 bn, uint32 *run);
+// 空洞 bn 的分配目标：紧接前一个 extent 末尾（按逻辑偏移外推），无前驱返回 0
+uint32 ext_goal(struct minode *ip, uint32 bn);
+// 把空洞 bn 映射到已分配的块 b：能紧接前一个 extent 时延长它，节点满时增高或分裂，失败返回 -1
+int ext_insert(struct minode *ip, uint32 bn, uint32 b);
+// 当前树高下一次 ext_insert 最多修改的块数（树块与其分配所改的位图块，不含 inode 块）
+int ext_insert_maxblocks(struct minode *ip);
+// 为空洞 bn 分配物理块并映射（ext_goal + ext_insert），失败返回 0
+uint32 ext_alloc(struct minode *ip, uint32 bn);
+// 释放全部数据块与 extent 树块
+void ext_truncate(struct minode *ip);
+// 截断时释放的块（数据块与树块）跨越的位图组数之和，同一组可能重复计入；group_bits 为每组位数
+uint32 ext_span_groups(struct minode *ip, uint32 group_bits);
+// extent 总数（调试与测试用）
+int ext_count(struct minode *ip);
+
+#endif
@@ -0,0 +1,121 @@
+#include "types.h"
+#include "string.h"
+#include "printf.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "log.h"
+#include "inode.h"
+#include "file.h"
+
+static struct file ftable[NFILE];
+static struct spinlock ftable_lock;   // 保护各对象的 ref
+
+// 尚无当前进程时（启动阶段）使用的描述符表
+static struct file *boot_ofile[NOFILE];
+
+void file_init(void) {
+  initlock(&ftable_lock, "ftable");
+}
+
+struct file *filealloc(void) {
+  acquire(&ftable_lock);
+  for (int i = 0; i < NFILE; i++) {
+    struct file *f = &ftable[i];
+    if (f->ref == 0) {
+      memset(f, 0, sizeof(*f));
+      f->ref = 1;
+      release(&ftable_lock);
+      return f;
+    }
+  }
+  release(&ftable_lock);
+  printf("file: table full\n");
+  return 0;
+}
+
+struct file *filedup(struct file *f) {
+  acquire(&ftable_lock);
+  if (f->ref < 1) panic("filedup");
+  f->ref++;
+  release(&ftable_lock);
+  return f;
+}
+
+void fileclose(struct file *f) {
+  acquire(&ftable_lock);
+  if (f->ref < 1) panic("fileclose");
+  if (--f->ref > 0) {
+    release(&ftable_lock);
+    return;
+  }
+  struct minode *ip = f->ip;
+  f->ip = 0;
+  release(&ftable_lock);
+  if (!ip) return;
+  // 关闭时回写脏页：延迟分配的块在此分配
+  if (f->writable) iflush(ip);
+  // 最后一个引用释放时可能截断并释放已删除的文件，需在事务中进行
+  begin_transaction_n(iput_opblocks(ip));
+  iput(ip);
+  end_transaction();
+}
+
+static struct file **fdtable(void) {
+  struct proc *p = get_current_process();
+  return p ? p->ofile : boot_ofile;
+}
+
+int fdalloc(struct file *f) {
+  struct file **ofile = fdtable();
+  for (int fd = 0; fd < NOFILE; fd++) {
+    if (ofile[fd] == 0) {
+      ofile[fd] = f;
+      return fd;
+    }
+  }
+  return -1;
+}
+
+struct file *fdget(int fd) {
+  if (fd < 0 || fd >= NOFILE) return 0;
+  return fdtable()[fd];
+}
+
+int fdclose(int fd) {
+  struct file *f = fdget(fd);
+  if (!f) return -1;
+  fdtable()[fd] = 0;
+  fileclose(f);
+  return 0;
+}
+
+int console_open(void) {
+  struct file *f = filealloc();
+  if (!f) return -1;
+  f->type = FD_CONSOLE;
+  f->writable = 1;
+  int fd = fdalloc(f);
+  if (fd < 0) fileclose(f);
+  return fd;
+}
+
+struct minode *fd_inode(int fd, int write) {
+  struct file *f = fdget(fd);
+  if (!f || f->type != FD_INODE || (write && !f->writable)) return 0;
+  return idup(f->ip);
+}
+
+void files_inherit(struct proc *child, struct proc *parent) {
+  for (int fd = 0; fd < NOFILE; fd++)
+    if (parent->ofile[fd]) child->ofile[fd] = filedup(parent->ofile[fd]);
+}
+
+void files_close(struct proc *p) {
+  for (int fd = 0; fd < NOFILE; fd++) {
+    struct file *f = p->ofile[fd];
+    if (f) {
+      p->ofile[fd] = 0;
+      fileclose(f);
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include "types.h"
+
+// 打开文件表：每次 open 得到一个带引用计数的打开文件对象，偏移保存在对象中
+// 每个进程一张描述符表（struct proc 的 ofile[]），fd 即表下标，查找 O(1)
+// 继承描述符的子进程与父进程共享同一对象（同 fork），因而共享偏移
+#define NFILE  128   // 全系统打开文件对象数
+#define NOFILE 16    // 每个进程的描述符数
+
+struct minode;
+struct proc;
+
+#define FD_INODE   1 // 文件系统中的文件
+#define FD_CONSOLE 2 // 控制台（只写）
+
+struct file {
+  int    ref;        // 引用此对象的描述符数，0 为空闲
+  int    type;
+  int    readable;
+  int    writable;
+  struct minode *ip; // 持有 inode 引用（FD_INODE）
+  uint32 off;        // 读写偏移（在 ilock 下更新）
+};
+
+void file_init(void);
+// 分配空闲对象（ref 为 1），表满返回 0
+struct file* filealloc(void);
+struct file* filedup(struct file *f);
+// 释放一个引用；最后一个引用回写脏页并放掉 inode（调用者不持有 ilock、不在事务中）
+void fileclose(struct file *f);
+
+// 在当前进程的描述符表中登记 f，返回 fd；表满返回 -1
+int fdalloc(struct file *f);
+// fd 对应的打开文件，无效返回 0
+struct file* fdget(int fd);
+// 从描述符表移除 fd 并释放其引用
+int fdclose(int fd);
+// 打开控制台作为只写描述符，返回 fd；失败返回 -1
+int console_open(void);
+// 打开文件的 inode（已引用），write 为 1 时要求可写；fd 无效或不是文件返回 0
+struct minode* fd_inode(int fd, int write);
+
+// 子进程继承父进程的全部描述符（创建时调用，子进程尚未运行）
+void files_inherit(struct proc *child, struct proc *parent);
+// 关闭进程的全部描述符（退出时调用）
+void files_close(struct proc *p);
+
+#endif
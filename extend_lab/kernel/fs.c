@@ -1,76 +1,1274 @@
 #include "types.h"
 #include "string.h"
+#include "printf.h"
 #include "fs.h"
+#include "bcache.h"
+#include "log.h"
+#include "inode.h"
+#include "dir.h"
+#include "extent.h"
+#include "pagecache.h"
+#include "timer.h"
+#include "dcache.h"
+#include "blkdev.h"
+#include "pmm.h"
+#include "file.h"
+#include "mmap.h"
 
-// 极简“文件系统”实现：仅支持一个内存文件，满足测试接口。
-typedef struct {
-  char name[64];
-  char data[4096];
-  int size;
-  int exists;
-} fake_file_t;
+// 控制台输出（sysproc.c）
+extern int sys_write(int fd, const char *buf, int n);
 
-static fake_file_t g_fake = {0};
-static int g_fd_in_use = -1;
-static int g_fp = 0; // 当前偏移
+// 块文件系统：超级块、inode/数据块位图、inode 表与数据区均在块设备上，
+// 元数据与文件数据的修改都经日志事务提交
 
-int open(const char *path, int flags) {
-  if (!path || path[0] == '\0') return -1;
-  if ((flags & O_CREATE) != 0) {
-    strncpy(g_fake.name, path, sizeof(g_fake.name)-1);
-    g_fake.name[sizeof(g_fake.name)-1] = '\0';
-    g_fake.size = 0;
-    g_fake.exists = 1;
-    g_fp = 0;
-    g_fd_in_use = 3; // 任意非负 fd
-    return g_fd_in_use;
-  }
-  if (g_fake.exists && strncmp(g_fake.name, path, sizeof(g_fake.name)) == 0) {
-    g_fp = 0;
-    g_fd_in_use = 3;
-    return g_fd_in_use;
+// 每个写事务最多写入的数据块数；预留按最坏情况估算：
+// 每个数据块可能新分配一个一级间接块，另加二级间接块、两个位图块与 inode 块
+#define FS_WRITE_CHUNK    8
+#define FS_WRITE_OPBLOCKS (2 * FS_WRITE_CHUNK + 4)
+// extent 文件延迟分配：写事务只修改 inode，数据留在页缓存中
+#define FS_DELAY_OPBLOCKS 2
+// 回写事务的预留：每分配一段连续块最多修改两个位图块，插入 extent 另计 ext_insert_maxblocks
+// （随树高增长，最高时也不超过预留），段首块可能仍被日志固定而经日志写；
+// 覆盖写的页若被固定各占一块；另加 inode 块
+#define FS_FLUSH_OPBLOCKS 20
+#define FS_FLUSH_RUNCOST(ip) (3 + ext_insert_maxblocks(ip))
+// 创建文件的预留：inode 位图与 inode 块，加上索引目录最坏情况下的分裂
+// （根、两个索引块、两个叶块、块位图、目录 inode 与间接块）
+#define FS_CREATE_OPBLOCKS 16
+// 删除目录项的预留（目录块、索引目录的块、目录与文件的 inode 块）；释放文件另计 iput_opblocks
+#define FS_UNLINK_OPBLOCKS 10
+// open 跟随符号链接的最大层数
+#define FS_SYMLINK_DEPTH 8
+
+// 已挂载的文件系统
+static int fs_dev = -1;
+static struct superblock fs_sb;
+
+// 位图分配器：每个位图块为一组，内存中保存各组空闲位数与 next-fit 起点，
+// 组内按 64 位字扫描，跳过已满的组与全 1 的字
+#define FS_GROUP_BITS (BLOCK_SIZE * 8)
+#define FS_GROUP_WORDS (BLOCK_SIZE / 8)
+struct bitmap_state {
+  uint32 start;                 // 位图首块号
+  uint32 nbits;                 // 有效位数
+  uint32 ngroups;               // 组数（位图块数）
+  uint32 hint;                  // 无目标时的分配起点：上一次分配之后
+  uint32 free[FS_MAX_GROUPS];   // 各组空闲位数
+};
+static struct bitmap_state blk_bits;
+static struct bitmap_state ino_bits;
+
+// 统计计数器
+uint64 fs_balloc_count = 0;
+uint64 fs_balloc_cycles = 0;
+uint64 fs_ialloc_count = 0;
+uint64 fs_ialloc_cycles = 0;
+uint64 fs_bitmap_words = 0;     // 分配时扫描的位图字数
+uint64 fs_delalloc_runs = 0;    // 回写时为延迟分配页分配的连续段数
+uint64 fs_delalloc_blocks = 0;  // 这些段的总块数
+
+// ===== 格式化与挂载 =====
+
+static int zero_blocks(int dev, uint32 start, uint32 n) {
+  for (uint32 b = start; b < start + n; b++) {
+    struct buffer_head *bh = get_block(dev, b);
+    if (!bh) return -1;
+    memset(bh->data, 0, BLOCK_SIZE);
+    bh->valid = 1;
+    bh->dirty = 1;
+    sync_block(bh);
+    put_block(bh);
+  }
+  return 0;
+}
+
+// 在位图块区域中置位第 bit 位（格式化时直接写盘，不经日志）
+static int bitmap_set_raw(int dev, uint32 bm_start, uint32 bit) {
+  struct buffer_head *bh = get_block(dev, bm_start + bit / (BLOCK_SIZE * 8));
+  if (!bh) return -1;
+  uint32 i = bit % (BLOCK_SIZE * 8);
+  bh->data[i / 8] |= (char)(1 << (i % 8));
+  bh->dirty = 1;
+  sync_block(bh);
+  put_block(bh);
+  return 0;
+}
+
+int fs_format(int dev, uint32 nblocks, uint32 ninodes) {
+  struct superblock sb;
+  memset(&sb, 0, sizeof(sb));
+  uint32 bits = BLOCK_SIZE * 8;
+  sb.magic = MYFS_MAGIC;
+  sb.version = MYFS_VERSION;
+  sb.block_size = BLOCK_SIZE;
+  sb.fs_size_blocks = nblocks;
+  sb.inode_count = ninodes;
+  sb.log_start = LOG_START;
+  sb.log_size = LOG_SIZE;
+  sb.inode_bitmap_start = LOG_START + LOG_SIZE;
+  sb.inode_bitmap_size = (ninodes + bits - 1) / bits;
+  sb.block_bitmap_start = sb.inode_bitmap_start + sb.inode_bitmap_size;
+  sb.block_bitmap_size = (nblocks + bits - 1) / bits;
+  sb.inode_table_start = sb.block_bitmap_start + sb.block_bitmap_size;
+  sb.inode_table_size = (ninodes + MYFS_IPB - 1) / MYFS_IPB;
+  sb.data_start = sb.inode_table_start + sb.inode_table_size;
+  sb.root_inode = 1;
+  if (ninodes < 2 || sb.data_start + 1 >= nblocks) {
+    printf("fs: format dev=%d too small (%d blocks, %d inodes)\n", dev, nblocks, ninodes);
+    return -1;
+  }
+  uint32 root_block = sb.data_start;
+  sb.free_inode_count = ninodes - 2;               // inode 0 保留，1 为根目录
+  sb.free_block_count = nblocks - root_block - 1;
+
+  // 日志区、位图与 inode 表清零
+  if (zero_blocks(dev, 0, sb.data_start) < 0) return -1;
+  // 超级块
+  struct buffer_head *bh = get_block(dev, SUPERBLOCK_NUM);
+  if (!bh) return -1;
+  memcpy(bh->data, &sb, sizeof(sb));
+  bh->dirty = 1;
+  sync_block(bh);
+  put_block(bh);
+  // 元数据区与根目录块在块位图中标记为已用；inode 0 与根 inode 在 inode 位图中已用
+  for (uint32 b = 0; b <= root_block; b++)
+    if (bitmap_set_raw(dev, sb.block_bitmap_start, b) < 0) return -1;
+  if (bitmap_set_raw(dev, sb.inode_bitmap_start, 0) < 0) return -1;
+  if (bitmap_set_raw(dev, sb.inode_bitmap_start, sb.root_inode) < 0) return -1;
+
+  // 根目录：含 "." 与 ".." 两项
+  bh = get_block(dev, root_block);
+  if (!bh) return -1;
+  memset(bh->data, 0, BLOCK_SIZE);
+  // "." 占最小长度，".." 覆盖块内其余空间
+  struct dirent *de = (struct dirent*)bh->data;
+  de->ino = sb.root_inode;
+  de->rec_len = (uint16)MYFS_DIRENT_LEN(1);
+  de->name_len = 1;
+  de->type = MYFT_DIR;
+  memcpy(de->name, ".", 1);
+  de = (struct dirent*)(bh->data + MYFS_DIRENT_LEN(1));
+  de->ino = sb.root_inode;
+  de->rec_len = (uint16)(BLOCK_SIZE - MYFS_DIRENT_LEN(1));
+  de->name_len = 2;
+  de->type = MYFT_DIR;
+  memcpy(de->name, "..", 2);
+  bh->dirty = 1;
+  sync_block(bh);
+  put_block(bh);
+
+  bh = get_block(dev, MYFS_IBLOCK(&sb, sb.root_inode));
+  if (!bh) return -1;
+  struct inode *root = (struct inode*)bh->data + sb.root_inode % MYFS_IPB;
+  root->mode = MYFS_MODE(MYFT_DIR, 0755);
+  root->nlink = 2;
+  root->size = BLOCK_SIZE;
+  root->blocks = 1;
+  root->direct[0] = root_block;
+  bh->dirty = 1;
+  sync_block(bh);
+  put_block(bh);
+  printf("fs: format dev=%d blocks=%d inodes=%d data_start=%d\n", dev, nblocks, ninodes, sb.data_start);
+  return 0;
+}
+
+// 最低置位的位号（x 非 0）；内核不链接 libgcc，不用编译器内建函数
+static inline int ctz64(uint64 x) {
+  int n = 0;
+  if ((x & 0xFFFFFFFFULL) == 0) { n += 32; x >>= 32; }
+  if ((x & 0xFFFF) == 0) { n += 16; x >>= 16; }
+  if ((x & 0xFF) == 0) { n += 8; x >>= 8; }
+  if ((x & 0xF) == 0) { n += 4; x >>= 4; }
+  if ((x & 0x3) == 0) { n += 2; x >>= 2; }
+  if ((x & 0x1) == 0) n += 1;
+  return n;
+}
+
+static inline int popcount64(uint64 x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+// 组 g 的有效位数（最后一组可能不满）
+static uint32 group_limit(struct bitmap_state *bs, uint32 g) {
+  uint32 left = bs->nbits - g * FS_GROUP_BITS;
+  return left < FS_GROUP_BITS ? left : FS_GROUP_BITS;
+}
+
+// 读入位图并统计各组空闲位数，返回总空闲数，失败返回 -1
+static int bitmap_setup(struct bitmap_state *bs, int dev, uint32 start, uint32 nbits) {
+  bs->start = start;
+  bs->nbits = nbits;
+  bs->ngroups = (nbits + FS_GROUP_BITS - 1) / FS_GROUP_BITS;
+  bs->hint = 0;
+  if (bs->ngroups > FS_MAX_GROUPS) {
+    printf("fs: bitmap of %d bits exceeds %d groups\n", nbits, FS_MAX_GROUPS);
+    return -1;
+  }
+  int total = 0;
+  for (uint32 g = 0; g < bs->ngroups; g++) {
+    struct buffer_head *bh = get_block(dev, start + g);
+    if (!bh || !bh->valid) {
+      if (bh) put_block(bh);
+      return -1;
+    }
+    const uint64 *w = (const uint64*)bh->data;
+    uint32 limit = group_limit(bs, g);
+    uint32 used = 0;
+    for (uint32 i = 0; i * 64 < limit; i++) {
+      uint64 word = w[i];
+      if (limit - i * 64 < 64) word &= (1ULL << (limit - i * 64)) - 1;
+      used += popcount64(word);
+    }
+    put_block(bh);
+    bs->free[g] = limit - used;
+    total += (int)bs->free[g];
+  }
+  return total;
+}
+
+int fs_mount(int dev) {
+  struct buffer_head *bh = get_block(dev, SUPERBLOCK_NUM);
+  if (!bh || !bh->valid) {
+    if (bh) put_block(bh);
+    printf("fs: mount dev=%d cannot read superblock\n", dev);
+    return -1;
+  }
+  memcpy(&fs_sb, bh->data, sizeof(fs_sb));
+  put_block(bh);
+  if (fs_sb.magic != MYFS_MAGIC || fs_sb.block_size != BLOCK_SIZE) {
+    printf("fs: mount dev=%d bad magic %x\n", dev, fs_sb.magic);
+    return -1;
+  }
+  if (fs_sb.version != MYFS_VERSION) {
+    printf("fs: mount dev=%d unsupported version %d\n", dev, fs_sb.version);
+    return -1;
+  }
+  fs_dev = dev;
+  // 先恢复日志，再建立 inode 缓存：重放可能改写 inode 表
+  log_init(dev, &fs_sb);
+  // 删除文件的事务最坏改动全部块位图块，须能放入一个事务组
+  if (FS_UNLINK_OPBLOCKS + 2 + (int)fs_sb.block_bitmap_size > log_capacity()) {
+    printf("fs: mount dev=%d block bitmap (%d blocks) too large for the log\n", dev, fs_sb.block_bitmap_size);
+    fs_dev = -1;
+    return -1;
+  }
+  pcache_init();
+  iinit(dev, &fs_sb);
+  dcache_init();
+  // 空闲计数以位图为准，运行期间在内存中维护
+  int fb = bitmap_setup(&blk_bits, dev, fs_sb.block_bitmap_start, fs_sb.fs_size_blocks);
+  int fi = bitmap_setup(&ino_bits, dev, fs_sb.inode_bitmap_start, fs_sb.inode_count);
+  if (fb < 0 || fi < 0) {
+    printf("fs: mount dev=%d cannot read bitmaps\n", dev);
+    fs_dev = -1;
+    return -1;
+  }
+  fs_sb.free_block_count = (uint32)fb;
+  fs_sb.free_inode_count = (uint32)fi;
+  blk_bits.hint = fs_sb.data_start;
+  printf("fs: mounted dev=%d free blocks=%d free inodes=%d\n", dev, fs_sb.free_block_count,
+         fs_sb.free_inode_count);
+  return 0;
+}
+
+int fs_superblock(struct superblock *out) {
+  if (fs_dev < 0 || !out) return -1;
+  memcpy(out, &fs_sb, sizeof(fs_sb));
+  return 0;
+}
+
+// ===== 位图分配（调用者处于事务中） =====
+
+// 在组位图 w 的 [from, limit) 中找第一个清零位，没有返回 -1
+static int group_scan(const uint64 *w, uint32 from, uint32 limit) {
+  uint32 i = from / 64;
+  uint64 word = ~w[i] & (~0ULL << (from % 64));
+  for (;;) {
+    fs_bitmap_words++;
+    if (word) {
+      uint32 bit = i * 64 + (uint32)ctz64(word);
+      return bit < limit ? (int)bit : -1;
+    }
+    if (++i * 64 >= limit) return -1;
+    word = ~w[i];
+  }
+}
+
+// 从第 start 位起找到第一个清零位并置位，返回位号，满时返回 -1
+// 空闲数为 0 的组不读位图块；扫描到末尾后回绕，最后回到起始组的前半段
+static int bitmap_alloc(struct bitmap_state *bs, uint32 start) {
+  if (start >= bs->nbits) start = 0;
+  uint32 g0 = start / FS_GROUP_BITS;
+  uint32 from = start % FS_GROUP_BITS;
+  for (uint32 k = 0; k <= bs->ngroups; k++, from = 0) {
+    uint32 g = (g0 + k) % bs->ngroups;
+    if (bs->free[g] == 0) continue;
+    struct buffer_head *bh = get_block(fs_dev, bs->start + g);
+    if (!bh) return -1;
+    int bit = group_scan((const uint64*)bh->data, from, group_limit(bs, g));
+    if (bit < 0) {
+      put_block(bh);
+      continue;
+    }
+    bh->data[bit / 8] |= (char)(1 << (bit % 8));
+    log_block_write(bh);
+    put_block(bh);
+    bs->free[g]--;
+    uint32 b = g * FS_GROUP_BITS + (uint32)bit;
+    bs->hint = b + 1;
+    return (int)b;
   }
   return -1;
 }
 
+static void bitmap_free(struct bitmap_state *bs, uint32 bit) {
+  struct buffer_head *bh = get_block(fs_dev, bs->start + bit / FS_GROUP_BITS);
+  if (!bh) return;
+  uint32 i = bit % FS_GROUP_BITS;
+  int m = 1 << (i % 8);
+  if ((bh->data[i / 8] & m) == 0) panic("fs: freeing free bit");
+  bh->data[i / 8] &= (char)~m;
+  log_block_write(bh);
+  put_block(bh);
+  bs->free[bit / FS_GROUP_BITS]++;
+}
+
+// 紧接已分配的第 bit 位继续占用其后至多 n 个空闲位（不跨组），返回占用的位数
+static uint32 bitmap_extend(struct bitmap_state *bs, uint32 bit, uint32 n) {
+  uint32 g = bit / FS_GROUP_BITS;
+  uint32 limit = group_limit(bs, g);
+  struct buffer_head *bh = get_block(fs_dev, bs->start + g);
+  if (!bh) return 0;
+  uint32 got = 0;
+  for (uint32 i = bit % FS_GROUP_BITS + 1; got < n && i < limit; i++, got++) {
+    int m = 1 << (i % 8);
+    if (bh->data[i / 8] & m) break;
+    bh->data[i / 8] |= (char)m;
+  }
+  if (got > 0) log_block_write(bh);
+  put_block(bh);
+  bs->free[g] -= got;
+  if (got > 0) bs->hint = bit + got + 1;
+  return got;
+}
+
+// 分配一个数据块，返回块号，空间不足返回 0；zero 为 1 时清零并记入日志
+// 优先取 goal，被占用时向后找最近的空闲块，使同一文件的块尽量连续；goal 为 0 时从上次分配处继续
+static uint32 balloc(uint32 goal, int zero) {
+  uint32 start = (goal >= fs_sb.data_start && goal < fs_sb.fs_size_blocks) ? goal : blk_bits.hint;
+  if (start < fs_sb.data_start) start = fs_sb.data_start;
+  uint64 t0 = get_time();
+  int b = bitmap_alloc(&blk_bits, start);
+  fs_balloc_cycles += get_time() - t0;
+  fs_balloc_count++;
+  if (b < 0) {
+    printf("fs: out of blocks\n");
+    return 0;
+  }
+  fs_sb.free_block_count--;
+  if (zero) {
+    struct buffer_head *bh = get_block(fs_dev, (uint)b);
+    if (bh) {
+      memset(bh->data, 0, BLOCK_SIZE);
+      log_block_write(bh);
+      put_block(bh);
+    }
+  }
+  return (uint32)b;
+}
+
+uint32 balloc_near(uint32 goal) {
+  return balloc(goal, 1);
+}
+
+// 文件数据块不经日志清零：写入路径在提交前把整页内容写到块上
+uint32 balloc_data(uint32 goal) {
+  return balloc(goal, 0);
+}
+
+// 从 goal 附近分配至多 want 个连续数据块（不清零），*got 为实际块数，失败返回 0
+// 首块同 balloc_data，之后沿位图向后占用空闲块，遇到仍被日志固定的块即停止：一段中只有首块可能需要经日志写
+static uint32 balloc_extent(uint32 goal, uint32 want, uint32 *got) {
+  *got = 0;
+  uint32 b = balloc_data(goal);
+  if (!b) return 0;
+  uint32 n = 1;
+  while (n < want && b + n < fs_sb.fs_size_blocks && !bcache_pinned(fs_dev, b + n)) n++;
+  uint32 more = n > 1 ? bitmap_extend(&blk_bits, b, n - 1) : 0;
+  fs_sb.free_block_count -= more;
+  *got = 1 + more;
+  return b;
+}
+
+void bfree(uint32 b) {
+  if (b < fs_sb.data_start || b >= fs_sb.fs_size_blocks) panic("fs: bfree bad block");
+  bitmap_free(&blk_bits, b);
+  fs_sb.free_block_count++;
+}
+
+struct minode* ialloc(int type) {
+  uint64 t0 = get_time();
+  int inum = bitmap_alloc(&ino_bits, ino_bits.hint);
+  fs_ialloc_cycles += get_time() - t0;
+  fs_ialloc_count++;
+  if (inum < 0) {
+    printf("fs: out of inodes\n");
+    return 0;
+  }
+  fs_sb.free_inode_count--;
+  struct minode *ip = iget((uint)fs_dev, (uint32)inum);
+  ilock(ip);
+  memset(&ip->d, 0, sizeof(ip->d));
+  ip->d.mode = MYFS_MODE(type, type == MYFT_DIR ? 0755 : 0644);
+  // 普通文件与符号链接先内联存放，增长后按 extent 映射；目录仍用直接块
+  if (type == MYFT_REG || type == MYFT_SYMLINK) {
+    ext_init(ip);
+    ip->d.flags |= MYFS_FL_INLINE;
+  }
+  iupdate(ip);
+  iunlock(ip);
+  return ip;
+}
+
+void ifree(struct minode *ip) {
+  bitmap_free(&ino_bits, ip->inum);
+  fs_sb.free_inode_count++;
+}
+
+// ===== 块映射 =====
+
+// 读取间接块 ind 中的第 idx 项；alloc 时为空项分配新块并记入日志，
+// 目标为前一项之后（没有前一项时紧跟间接块本身）
+static uint32 ind_entry(uint32 ind, uint32 idx, int alloc, struct minode *ip) {
+  struct buffer_head *bh = get_block(fs_dev, ind);
+  if (!bh) return 0;
+  uint32 *a = (uint32*)bh->data;
+  uint32 b = a[idx];
+  if (b == 0 && alloc) {
+    b = balloc_near((idx > 0 && a[idx - 1]) ? a[idx - 1] + 1 : ind + 1);
+    if (b) {
+      a[idx] = b;
+      ip->d.blocks++;
+      log_block_write(bh);
+    }
+  }
+  put_block(bh);
+  return b;
+}
+
+// 取得（或分配）inode 指针槽 *slot 指向的块，分配时尽量靠近 goal
+static uint32 slot_block(uint32 *slot, int alloc, struct minode *ip, uint32 goal) {
+  if (*slot == 0 && alloc) {
+    *slot = balloc_near(goal);
+    if (*slot) ip->d.blocks++;
+  }
+  return *slot;
+}
+
+// 文件逻辑块号 bn 对应的磁盘块号：extent 树，或直接块、一级间接、二级间接
+// alloc 为 1 时沿途分配缺失的块（调用者持有 ilock 并处于事务中），否则空洞返回 0
+uint32 bmap(struct minode *ip, uint32 bn, int alloc) {
+  if (ip->d.flags & MYFS_FL_EXTENTS) {
+    uint32 run;
+    uint32 b = ext_map(ip, bn, &run);
+    return (b == 0 && alloc) ? ext_alloc(ip, bn) : b;
+  }
+  // 直接块与间接块的分配目标都是文件已有的最后一个直接块之后
+  uint32 goal = 0;
+  for (int i = (bn < MYFS_NDIRECT ? (int)bn : MYFS_NDIRECT) - 1; i >= 0 && !goal; i--)
+    if (ip->d.direct[i]) goal = ip->d.direct[i] + 1;
+  if (bn < MYFS_NDIRECT) return slot_block(&ip->d.direct[bn], alloc, ip, goal);
+  bn -= MYFS_NDIRECT;
+  if (bn < MYFS_PTRS_PER_BLOCK) {
+    uint32 ind = slot_block(&ip->d.indirect, alloc, ip, goal);
+    return ind ? ind_entry(ind, bn, alloc, ip) : 0;
+  }
+  bn -= MYFS_PTRS_PER_BLOCK;
+  if (bn < MYFS_MAX_DOUBLE_INDIRECT) {
+    uint32 dind = slot_block(&ip->d.double_indirect, alloc, ip, goal);
+    if (!dind) return 0;
+    uint32 ind = ind_entry(dind, bn / MYFS_PTRS_PER_BLOCK, alloc, ip);
+    return ind ? ind_entry(ind, bn % MYFS_PTRS_PER_BLOCK, alloc, ip) : 0;
+  }
+  return 0;
+}
+
+// 释放间接块 ind 及其指向的块；depth 为 2 时各项本身也是间接块
+static void free_ind(uint32 ind, int depth) {
+  struct buffer_head *bh = get_block(fs_dev, ind);
+  if (bh) {
+    uint32 *a = (uint32*)bh->data;
+    for (uint32 i = 0; i < MYFS_PTRS_PER_BLOCK; i++) {
+      if (a[i] == 0) continue;
+      if (depth > 1) free_ind(a[i], depth - 1);
+      else bfree(a[i]);
+    }
+    put_block(bh);
+  }
+  bfree(ind);
+}
+
+// 截断改动的块位图块按文件的 extent 跨越的位图组估算（重复计入只会多预留），
+// 不超过块位图的总块数；另加 inode 块与 inode 位图块
+int iput_opblocks(struct minode *ip) {
+  uint32 groups = fs_sb.block_bitmap_size;
+  ilock(ip);
+  if (ip->d.flags & MYFS_FL_INLINE) {
+    groups = 0;
+  } else if (ip->d.flags & MYFS_FL_EXTENTS) {
+    uint32 g = ext_span_groups(ip, FS_GROUP_BITS);
+    if (g < groups) groups = g;
+  }
+  iunlock(ip);
+  return 2 + (int)groups;
+}
+
+// 释放文件的全部数据块（调用者持有 ilock 并处于事务中）
+// extent 文件截断后回到内联存放
+void itrunc(struct minode *ip) {
+  if (ip->d.flags & (MYFS_FL_INLINE | MYFS_FL_EXTENTS)) {
+    pcache_truncate(ip, 0);
+    if (!(ip->d.flags & MYFS_FL_INLINE)) ext_truncate(ip);
+    memset(ip->d.inline_data, 0, MYFS_INLINE_MAX);
+    ip->d.flags |= MYFS_FL_INLINE;
+    ip->d.size = 0;
+    ip->d.blocks = 0;
+    iupdate(ip);
+    return;
+  }
+  for (int i = 0; i < MYFS_NDIRECT; i++) {
+    if (ip->d.direct[i]) {
+      bfree(ip->d.direct[i]);
+      ip->d.direct[i] = 0;
+    }
+  }
+  if (ip->d.indirect) {
+    free_ind(ip->d.indirect, 1);
+    ip->d.indirect = 0;
+  }
+  if (ip->d.double_indirect) {
+    free_ind(ip->d.double_indirect, 2);
+    ip->d.double_indirect = 0;
+  }
+  ip->d.size = 0;
+  ip->d.blocks = 0;
+  iupdate(ip);
+}
+
+// ===== 文件数据读写（调用者持有 ilock） =====
+// extent 文件的数据经页缓存读写，不占用块缓存；目录等块映射文件仍逐块经块缓存
+
+// 填充无效页 pg：空洞清零；否则把同一物理连续段中其后（页号不超过 last）的无效页一并读入，一次派发
+static int page_fill(struct minode *ip, struct cpage *pg, uint32 last) {
+  uint32 run;
+  uint32 b = ext_map(ip, pg->index, &run);
+  if (b == 0) {
+    memset(pg->data, 0, BLOCK_SIZE);
+    pg->valid = 1;
+    return 0;
+  }
+  struct cpage *batch[PCACHE_BATCH];
+  uint32 blocks[PCACHE_BATCH];
+  char *bufs[PCACHE_BATCH];
+  batch[0] = pg;
+  int k = 1;
+  for (; k < PCACHE_BATCH && (uint32)k < run && pg->index + k <= last; k++) {
+    struct cpage *q = pcache_get(ip, pg->index + k);
+    if (!q) break;
+    if (q->valid) {
+      pcache_put(q);
+      break;
+    }
+    batch[k] = q;
+  }
+  for (int i = 0; i < k; i++) {
+    blocks[i] = b + i;
+    bufs[i] = batch[i]->data;
+  }
+  int r = bcache_direct_io(fs_dev, BLK_READ, blocks, bufs, k);
+  for (int i = 0; i < k; i++) {
+    if (r == 0) batch[i]->valid = 1;
+    if (i > 0) pcache_put(batch[i]);
+  }
+  return r == 0 ? 0 : -1;
+}
+
+// 把一批脏页写到各自的块上，一次派发（相邻块在请求层合并为一个请求）
+// 写出前置为干净并撤销共享映射的写权限：写出期间经映射的写入重新缺页置脏，失败时重新置脏
+// 仍被日志固定的块（刚由元数据释放后重新分配）改经日志写，否则重放时旧内容会覆盖新数据
+static int page_write(struct cpage **batch, const uint32 *blocks, int k) {
+  uint32 direct[PCACHE_WB_BATCH];
+  char *bufs[PCACHE_WB_BATCH];
+  int nd = 0, r = 0;
+  for (int i = 0; i < k; i++) mmap_mkclean(batch[i]);
+  for (int i = 0; i < k; i++) {
+    if (!bcache_pinned(fs_dev, blocks[i])) {
+      direct[nd] = blocks[i];
+      bufs[nd++] = batch[i]->data;
+      continue;
+    }
+    struct buffer_head *bh = get_block(fs_dev, blocks[i]);
+    if (!bh) {
+      r = -1;
+      continue;
+    }
+    memcpy(bh->data, batch[i]->data, BLOCK_SIZE);
+    log_block_write(bh);
+    put_block(bh);
+  }
+  if (nd > 0 && bcache_direct_io(fs_dev, BLK_WRITE, direct, bufs, nd) != 0) r = -1;
+  if (r < 0)
+    for (int i = 0; i < k; i++) pcache_mark_dirty(batch[i], 0);
+  return r;
+}
+
+// 写入 extent 文件的 [off, off+n)：只复制到页缓存并置脏，返回写入的字节数
+// 空洞处的页不分配块（延迟分配），回写时整段分配；空闲块需为这些页预留，不足时提前停止
+static uint32 write_pages(struct minode *ip, const char *src, uint32 off, uint32 n) {
+  uint32 done = 0;
+  uint32 run_bn = 0, run_pb = 0, run_len = 0;
+  while (done < n) {
+    uint32 pos = off + done;
+    uint32 boff = pos % BLOCK_SIZE;
+    uint32 m = BLOCK_SIZE - boff;
+    if (m > n - done) m = n - done;
+    uint32 bn = pos / BLOCK_SIZE;
+    struct cpage *pg = pcache_get(ip, bn);
+    if (!pg) break;
+    if (!pg->valid && m < BLOCK_SIZE && page_fill(ip, pg, bn) < 0) {
+      pcache_put(pg);
+      break;
+    }
+    int delay = 0;
+    if (!pg->delay) {
+      if (bn < run_bn || bn >= run_bn + run_len) {
+        run_pb = ext_map(ip, bn, &run_len);
+        run_bn = bn;
+      }
+      if (run_pb == 0) {
+        if (fs_sb.free_block_count <= (uint32)pcache_delayed + FS_DELALLOC_SLACK) {
+          pcache_put(pg);
+          break;
+        }
+        delay = 1;
+      }
+    }
+    memcpy(pg->data + boff, src + done, m);
+    pg->valid = 1;
+    pcache_mark_dirty(pg, delay);
+    pcache_put(pg);
+    done += m;
+  }
+  return done;
+}
+
+// 回写 ip 的一批脏页，返回写出的页数，出错返回 -1（调用者持有 ilock，处于 FS_FLUSH_OPBLOCKS 的事务中）
+// 按页号顺序处理：已有块的页原位写；连续的延迟分配页一次分配一段连续块并追加为 extent；
+// 各页按块号成批派发，事务提交前数据已写到块上（有序模式）
+static int writeback_pages(struct minode *ip) {
+  struct cpage **pages = (struct cpage**)alloc_page();
+  if (!pages) return -1;
+  int n = pcache_dirty_pages(ip, pages, PCACHE_NPAGES);
+  struct cpage *batch[PCACHE_WB_BATCH];
+  uint32 blocks[PCACHE_WB_BATCH];
+  int k = 0, done = 0, err = 0;
+  int budget = FS_FLUSH_OPBLOCKS - 1;
+  int i = 0;
+  while (i < n && !err) {
+    struct cpage *pg = pages[i];
+    uint32 b, got = 1;
+    if (!pg->delay) {
+      uint32 run;
+      b = ext_map(ip, pg->index, &run);
+      if (b == 0) {
+        err = 1;
+        break;
+      }
+      if (bcache_pinned(fs_dev, b)) {
+        if (budget < 1) break;
+        budget--;
+      }
+    } else {
+      if (budget < FS_FLUSH_RUNCOST(ip)) break;
+      budget -= FS_FLUSH_RUNCOST(ip);
+      uint32 want = 1;
+      while (i + (int)want < n && pages[i + want]->delay && pages[i + want]->index == pg->index + want) want++;
+      b = balloc_extent(ext_goal(ip, pg->index), want, &got);
+      if (!b) {
+        err = 1;
+        break;
+      }
+      for (uint32 j = 0; j < got; j++) {
+        if (ext_insert(ip, pg->index + j, b + j) < 0) {
+          for (uint32 x = j; x < got; x++) bfree(b + x);
+          got = j;
+          err = 1;
+          break;
+        }
+        pcache_mark_mapped(pages[i + j]);
+      }
+      fs_delalloc_runs++;
+      fs_delalloc_blocks += got;
+    }
+    for (uint32 j = 0; j < got; j++) {
+      batch[k] = pages[i + j];
+      blocks[k++] = b + j;
+      if (k == PCACHE_WB_BATCH) {
+        if (page_write(batch, blocks, k) < 0) err = 1;
+        done += k;
+        k = 0;
+      }
+    }
+    i += (int)got;
+  }
+  if (k > 0) {
+    if (page_write(batch, blocks, k) < 0) err = 1;
+    done += k;
+  }
+  for (int j = 0; j < n; j++) pcache_put(pages[j]);
+  free_page(pages);
+  iupdate(ip);
+  return err ? -1 : done;
+}
+
+int iflush(struct minode *ip) {
+  for (;;) {
+    begin_transaction_n(FS_FLUSH_OPBLOCKS);
+    ilock(ip);
+    // 已无目录项的文件不必回写：最后一次 iput 截断时丢弃这些页
+    int r = (ip->d.nlink == 0 || ip->pc_npages == 0) ? 0 : writeback_pages(ip);
+    iunlock(ip);
+    end_transaction();
+    if (r <= 0) return r;
+  }
+}
+
+// 映射的页直接是缓存页本身，读写与 readi/writei 看到同一份数据
+struct cpage *igetpage(struct minode *ip, uint32 index) {
+  struct cpage *pg = 0;
+  ilock(ip);
+  if (!(ip->d.flags & MYFS_FL_INLINE) && (uint64)index * BLOCK_SIZE < ip->d.size) {
+    pg = pcache_get(ip, index);
+    if (pg && !pg->valid && page_fill(ip, pg, index) < 0) {
+      pcache_put(pg);
+      pg = 0;
+    }
+  }
+  iunlock(ip);
+  return pg;
+}
+
+// 与 write_pages 相同：空洞上的页延迟分配，需有空闲块预留
+int idirtypage(struct minode *ip, struct cpage *pg) {
+  int delay = 0, r = 0;
+  ilock(ip);
+  if (!pg->delay) {
+    uint32 run;
+    if (ext_map(ip, pg->index, &run) == 0) {
+      if (fs_sb.free_block_count <= (uint32)pcache_delayed + FS_DELALLOC_SLACK) r = -1;
+      delay = 1;
+    }
+  }
+  if (r == 0) pcache_mark_dirty(pg, delay);
+  iunlock(ip);
+  return r;
+}
+
+// 按映射段读取：一个 extent 内的块不再逐块查映射；内联文件直接从 inode 复制
+int readi(struct minode *ip, char *dst, uint32 off, uint32 n) {
+  if (off >= ip->d.size) return 0;
+  if (n > ip->d.size - off) n = ip->d.size - off;
+  if (ip->d.flags & MYFS_FL_INLINE) {
+    memcpy(dst, ip->d.inline_data + off, n);
+    return (int)n;
+  }
+  uint32 done = 0;
+  if (ip->d.flags & MYFS_FL_EXTENTS) {
+    uint32 last = (off + n - 1) / BLOCK_SIZE;
+    while (done < n) {
+      uint32 pos = off + done;
+      uint32 boff = pos % BLOCK_SIZE;
+      uint32 m = BLOCK_SIZE - boff;
+      if (m > n - done) m = n - done;
+      struct cpage *pg = pcache_get(ip, pos / BLOCK_SIZE);
+      if (!pg || (!pg->valid && page_fill(ip, pg, last) < 0)) {
+        if (pg) pcache_put(pg);
+        return done > 0 ? (int)done : -1;
+      }
+      memcpy(dst + done, pg->data + boff, m);
+      pcache_put(pg);
+      done += m;
+    }
+    return (int)done;
+  }
+  while (done < n) {
+    uint32 pos = off + done;
+    uint32 boff = pos % BLOCK_SIZE;
+    uint32 m = BLOCK_SIZE - boff;
+    if (m > n - done) m = n - done;
+    uint32 b = bmap(ip, pos / BLOCK_SIZE, 0);
+    if (b == 0) {
+      memset(dst + done, 0, m); // 空洞
+    } else {
+      struct buffer_head *bh = get_block(fs_dev, b);
+      if (!bh || !bh->valid) {
+        if (bh) put_block(bh);
+        return done > 0 ? (int)done : -1;
+      }
+      memcpy(dst + done, bh->data + boff, m);
+      put_block(bh);
+    }
+    done += m;
+  }
+  return (int)done;
+}
+
+// 调用者处于事务中
+// 内联数据移入文件第 0 页（延迟分配，回写时才分配块）并清除 MYFS_FL_INLINE
+static int inline_to_blocks(struct minode *ip) {
+  char data[MYFS_INLINE_MAX];
+  uint32 size = ip->d.size;
+  memcpy(data, ip->d.inline_data, size);
+  memset(ip->d.inline_data, 0, MYFS_INLINE_MAX);
+  ip->d.flags &= ~MYFS_FL_INLINE;
+  if (size > 0 && write_pages(ip, data, 0, size) != size) {
+    pcache_truncate(ip, 0);
+    ext_truncate(ip);
+    memcpy(ip->d.inline_data, data, size);
+    ip->d.flags |= MYFS_FL_INLINE;
+    ip->d.blocks = 0;
+    return -1;
+  }
+  iupdate(ip);
+  return 0;
+}
+
+int writei(struct minode *ip, const char *src, uint32 off, uint32 n) {
+  if ((uint64)off + n > MYFS_MAX_FILE_SIZE) return -1;
+  if (ip->d.flags & MYFS_FL_INLINE) {
+    // 仍放得下时只修改 inode，不分配数据块
+    if ((uint64)off + n <= MYFS_INLINE_MAX) {
+      memcpy(ip->d.inline_data + off, src, n);
+      if (off + n > ip->d.size) ip->d.size = off + n;
+      iupdate(ip);
+      return (int)n;
+    }
+    if (inline_to_blocks(ip) < 0) return -1;
+  }
+  uint32 done = 0;
+  if (ip->d.flags & MYFS_FL_EXTENTS) {
+    done = write_pages(ip, src, off, n);
+  } else {
+    while (done < n) {
+      uint32 pos = off + done;
+      uint32 boff = pos % BLOCK_SIZE;
+      uint32 m = BLOCK_SIZE - boff;
+      if (m > n - done) m = n - done;
+      uint32 b = bmap(ip, pos / BLOCK_SIZE, 1);
+      if (b == 0) break;
+      struct buffer_head *bh = get_block(fs_dev, b);
+      if (!bh) break;
+      memcpy(bh->data + boff, src + done, m);
+      log_block_write(bh);
+      put_block(bh);
+      done += m;
+    }
+  }
+  if (off + done > ip->d.size) ip->d.size = off + done;
+  // 即使大小未变，bmap 也可能修改了块指针
+  iupdate(ip);
+  return done > 0 || n == 0 ? (int)done : -1;
+}
+
+// ===== 文件接口 =====
+// 描述符与偏移由 file.c 的打开文件表维护
+
+// 在父目录中创建普通文件或目录，已存在同类型文件时返回现有 inode（均为已引用、未加锁）
+// 新目录含 "." 与 ".."，父目录的链接数随 ".." 加一
+static struct minode *create(char *path, int type) {
+  char name[DIR_MAX_NAME + 1];
+  struct minode *dp = path_parent(path, name);
+  if (!dp) return 0;
+  ilock(dp);
+  struct minode *ip = dir_lookup(dp, name, 0);
+  if (ip) {
+    iunlockput(dp);
+    ilock(ip);
+    int t = MYFS_TYPE(ip->d.mode);
+    iunlock(ip);
+    if (t == type) return ip;
+    iput(ip);
+    return 0;
+  }
+  ip = ialloc(type);
+  if (!ip) {
+    iunlockput(dp);
+    return 0;
+  }
+  ilock(ip);
+  ip->d.nlink = (type == MYFT_DIR) ? 2 : 1;
+  iupdate(ip);
+  if (type == MYFT_DIR && (dir_link(ip, ".", ip->inum, MYFT_DIR) < 0 || dir_link(ip, "..", dp->inum, MYFT_DIR) < 0)) {
+    ip->d.nlink = 0;
+    iupdate(ip);
+    iunlock(ip);
+    iunlockput(dp);
+    iput(ip);
+    return 0;
+  }
+  iunlock(ip);
+  if (dir_link(dp, name, ip->inum, type) < 0) {
+    // 目录项写入失败：撤销分配（nlink 归零后由 iput 释放）
+    ilock(ip);
+    ip->d.nlink = 0;
+    iupdate(ip);
+    iunlock(ip);
+    iunlockput(dp);
+    iput(ip);
+    return 0;
+  }
+  if (type == MYFT_DIR) {
+    dp->d.nlink++;
+    iupdate(dp);
+  }
+  iunlockput(dp);
+  return ip;
+}
+
+// 跟随符号链接直到非链接文件，层数超过 FS_SYMLINK_DEPTH 或目标不存在时返回 0
+static struct minode *follow_symlinks(struct minode *ip) {
+  char target[MYFS_SYMLINK_MAX + 1];
+  for (int depth = 0; ip; depth++) {
+    ilock(ip);
+    if (MYFS_TYPE(ip->d.mode) != MYFT_SYMLINK) {
+      iunlock(ip);
+      return ip;
+    }
+    int n = depth < FS_SYMLINK_DEPTH ? readi(ip, target, 0, MYFS_SYMLINK_MAX) : -1;
+    iunlockput(ip);
+    if (n <= 0) return 0;
+    target[n] = '\0';
+    ip = path_walk(target);
+  }
+  return 0;
+}
+
+int open(const char *path, int flags) {
+  if (!path || path[0] == '\0' || fs_dev < 0) return -1;
+  struct minode *ip = path_walk((char*)path);
+  if (!ip && (flags & O_CREATE) != 0) {
+    begin_transaction_n(FS_CREATE_OPBLOCKS);
+    ip = create((char*)path, MYFT_REG);
+    end_transaction();
+  }
+  ip = follow_symlinks(ip);
+  if (!ip) return -1;
+  ilock(ip);
+  int t = MYFS_TYPE(ip->d.mode);
+  iunlock(ip);
+  if (t == MYFT_DIR && (flags & O_RDWR)) {
+    iput(ip);
+    return -1;
+  }
+  struct file *f = filealloc();
+  int fd = f ? fdalloc(f) : -1;
+  if (fd < 0) {
+    if (f) fileclose(f);
+    iput(ip);
+    return -1;
+  }
+  f->type = FD_INODE;
+  f->ip = ip;
+  f->readable = 1;
+  f->writable = (flags & O_RDWR) != 0;
+  return fd;
+}
+
 int write(int fd, const void *buf, int n) {
-  if (fd != g_fd_in_use || !buf || n < 0) return -1;
-  if (!g_fake.exists) return -1;
-  int space = (int)sizeof(g_fake.data) - g_fp;
-  int w = n < space ? n : space;
-  if (w > 0) {
-    memcpy(g_fake.data + g_fp, buf, (size_t)w);
-    g_fp += w;
-    if (g_fp > g_fake.size) g_fake.size = g_fp;
+  struct file *f = fdget(fd);
+  if (!f || !f->writable || !buf || n < 0) return -1;
+  if (f->type == FD_CONSOLE) return sys_write(fd, buf, n);
+  struct minode *ip = f->ip;
+  // 源缓冲区在映射窗口内时，每轮先在加锁与开始事务之前复制一页到内核页：
+  // 持有 ilock 缺页会再取所映射文件的 ilock（同一文件自锁，两个文件相互等待）
+  char *bounce = 0;
+  if (MMAP_RANGE(buf, n) && !(bounce = (char*)alloc_page())) return -1;
+  int done = 0;
+  // 分多个事务写入，每个事务的块数不超过预留
+  while (done < n) {
+    // 脏页过多时先回写，为本次写入腾出干净页
+    if (pcache_ndirty >= PCACHE_DIRTY_HIGH && iflush(ip) < 0) break;
+    int m = n - done;
+    const char *src = (const char*)buf + done;
+    if (bounce) {
+      if (m > PGSIZE) m = PGSIZE;
+      memcpy(bounce, src, m);
+      src = bounce;
+    }
+    begin_transaction_n((ip->d.flags & MYFS_FL_EXTENTS) ? FS_DELAY_OPBLOCKS : FS_WRITE_OPBLOCKS);
+    ilock(ip);
+    // 共享同一打开文件的进程并发写入时，偏移在 ilock 下读取并推进
+    uint32 off = f->off;
+    int max = FS_WRITE_CHUNK * BLOCK_SIZE - (int)(off % BLOCK_SIZE);
+    if (m > max) m = max;
+    int r = writei(ip, src, off, (uint32)m);
+    if (r > 0) f->off = off + (uint32)r;
+    iunlock(ip);
+    end_transaction();
+    if (r <= 0) break;
+    done += r;
+    if (r < m) break;
   }
-  return w;
+  if (bounce) free_page(bounce);
+  return done > 0 || n == 0 ? done : -1;
 }
 
 int read(int fd, void *buf, int n) {
-  if (fd != g_fd_in_use || !buf || n < 0) return -1;
-  if (!g_fake.exists) return -1;
-  int remain = g_fake.size - g_fp;
-  if (remain <= 0) return 0;
-  int r = n < remain ? n : remain;
-  memcpy(buf, g_fake.data + g_fp, (size_t)r);
-  g_fp += r;
-  return r;
+  struct file *f = fdget(fd);
+  if (!f || !f->readable || !buf || n < 0) return -1;
+  if (!MMAP_RANGE(buf, n)) {
+    ilock(f->ip);
+    int r = readi(f->ip, (char*)buf, f->off, (uint32)n);
+    if (r > 0) f->off += (uint32)r;
+    iunlock(f->ip);
+    return r;
+  }
+  // 目标在映射窗口内：经内核页中转，放开 ilock 后再复制出去（理由同 write）
+  char *bounce = (char*)alloc_page();
+  if (!bounce) return -1;
+  int done = 0, r = 0;
+  while (done < n) {
+    int m = n - done;
+    if (m > PGSIZE) m = PGSIZE;
+    ilock(f->ip);
+    r = readi(f->ip, bounce, f->off, (uint32)m);
+    if (r > 0) f->off += (uint32)r;
+    iunlock(f->ip);
+    if (r <= 0) break;
+    memcpy((char*)buf + done, bounce, r);
+    done += r;
+    if (r < m) break;
+  }
+  free_page(bounce);
+  return done > 0 ? done : r;
 }
 
 int close(int fd) {
-  if (fd != g_fd_in_use) return -1;
-  g_fd_in_use = -1;
-  g_fp = 0;
-  return 0;
+  return fdclose(fd);
+}
+
+// ===== 描述符之间的复制 =====
+// 数据从源文件的缓存页直接复制到目标文件的缓存页（或逐字节送往控制台），不经调用者的缓冲区
+// 内联的源文件至多 MYFS_INLINE_MAX 字节，先复制到栈上
+
+// 把 k 段数据依次追加到 out 的当前偏移，一个事务，返回写入的字节数
+// 各段是源文件的缓存页或栈上副本，不在映射窗口内，持有 ilock 复制不会缺页
+static int copy_to_file(struct file *out, const char **data, const uint32 *len, int k) {
+  struct minode *ip = out->ip;
+  if (pcache_ndirty >= PCACHE_DIRTY_HIGH && iflush(ip) < 0) return -1;
+  begin_transaction_n((ip->d.flags & MYFS_FL_EXTENTS) ? FS_DELAY_OPBLOCKS : FS_WRITE_OPBLOCKS);
+  ilock(ip);
+  uint32 off = out->off;
+  int done = 0;
+  for (int i = 0; i < k; i++) {
+    int r = writei(ip, data[i], off + (uint32)done, len[i]);
+    if (r > 0) done += r;
+    if (r < (int)len[i]) break;
+  }
+  out->off = off + (uint32)done;
+  iunlock(ip);
+  end_transaction();
+  return done;
+}
+
+static int copy_to_console(const char **data, const uint32 *len, int k) {
+  int done = 0;
+  for (int i = 0; i < k; i++) done += sys_write(-1, data[i], (int)len[i]);
+  return done;
+}
+
+// 从 in 的偏移起复制至多 n 字节到 out，每轮至多 FS_WRITE_CHUNK 页，两边偏移各自推进；源在文件末尾时返回 0
+static int file_copy(struct file *in, struct file *out, int n) {
+  struct minode *src = in->ip;
+  char tmp[MYFS_INLINE_MAX];
+  int done = 0, err = 0;
+  while (done < n) {
+    struct cpage *pgs[FS_WRITE_CHUNK];
+    const char *data[FS_WRITE_CHUNK];
+    uint32 len[FS_WRITE_CHUNK];
+    uint32 want = (uint32)(n - done), total = 0;
+    int k = 0;
+    ilock(src);
+    uint32 off = in->off;
+    uint32 size = src->d.size;
+    int inl = (src->d.flags & MYFS_FL_INLINE) != 0;
+    if (inl && off < size) {
+      int r = readi(src, tmp, off, want);
+      if (r > 0) {
+        pgs[0] = 0;
+        data[0] = tmp;
+        len[0] = (uint32)r;
+        total = (uint32)r;
+        k = 1;
+      }
+    }
+    iunlock(src);
+    while (!inl && k < FS_WRITE_CHUNK && total < want && off + total < size) {
+      uint32 pos = off + total;
+      uint32 boff = pos % BLOCK_SIZE;
+      uint32 m = BLOCK_SIZE - boff;
+      if (m > size - pos) m = size - pos;
+      if (m > want - total) m = want - total;
+      struct cpage *pg = igetpage(src, pos / BLOCK_SIZE);
+      if (!pg) break;
+      pgs[k] = pg;
+      data[k] = pg->data + boff;
+      len[k++] = m;
+      total += m;
+    }
+    if (k == 0) {
+      err = off < size;   // 未到文件末尾却取不到页
+      break;
+    }
+    int r = out->type == FD_CONSOLE ? copy_to_console(data, len, k) : copy_to_file(out, data, len, k);
+    for (int i = 0; i < k; i++)
+      if (pgs[i]) pcache_put(pgs[i]);
+    if (r > 0) {
+      ilock(src);
+      in->off = off + (uint32)r;
+      iunlock(src);
+      done += r;
+    }
+    if (r < (int)total) {
+      err = 1;
+      break;
+    }
+  }
+  return done > 0 || !err ? done : -1;
+}
+
+int copy_file_range(int fd_in, int fd_out, int n) {
+  struct file *in = fdget(fd_in), *out = fdget(fd_out);
+  if (!in || !out || in->type != FD_INODE || out->type != FD_INODE) return -1;
+  if (!in->readable || !out->writable || n < 0) return -1;
+  // 同一文件内的重叠区间会读到刚写入的数据
+  if (in->ip == out->ip && in->off < out->off + (uint32)n && out->off < in->off + (uint32)n) return -1;
+  return file_copy(in, out, n);
+}
+
+int sendfile(int out_fd, int in_fd, int n) {
+  struct file *in = fdget(in_fd), *out = fdget(out_fd);
+  if (!in || !out || in->type != FD_INODE || !in->readable || !out->writable || n < 0) return -1;
+  if (out->type == FD_INODE) return copy_file_range(in_fd, out_fd, n);
+  return file_copy(in, out, n);
+}
+
+// 只有 extent 格式的普通文件经页缓存，可以映射
+int imap_prepare(struct minode *ip) {
+  int r = 0;
+  begin_transaction_n(FS_DELAY_OPBLOCKS);
+  ilock(ip);
+  if (MYFS_TYPE(ip->d.mode) != MYFT_REG || !(ip->d.flags & MYFS_FL_EXTENTS)) r = -1;
+  else if (ip->d.flags & MYFS_FL_INLINE) r = inline_to_blocks(ip);
+  iunlock(ip);
+  end_transaction();
+  return r;
+}
+
+int mkdir(const char *path) {
+  if (!path || path[0] == '\0' || fs_dev < 0) return -1;
+  struct minode *ip = path_walk((char*)path);
+  if (ip) {
+    iput(ip);
+    return -1;
+  }
+  begin_transaction_n(FS_CREATE_OPBLOCKS);
+  ip = create((char*)path, MYFT_DIR);
+  if (ip) iput(ip);
+  end_transaction();
+  return ip ? 0 : -1;
+}
+
+int symlink(const char *target, const char *path) {
+  if (!target || !path || path[0] == '\0' || fs_dev < 0) return -1;
+  uint32 len = strlen(target);
+  if (len == 0 || len > MYFS_SYMLINK_MAX) return -1;
+  struct minode *ip = path_walk((char*)path);
+  if (ip) {
+    iput(ip);
+    return -1;
+  }
+  begin_transaction_n(FS_CREATE_OPBLOCKS);
+  ip = create((char*)path, MYFT_SYMLINK);
+  int r = -1;
+  if (ip) {
+    // 短目标留在 inode 中；更长的目标占一个数据块
+    ilock(ip);
+    r = writei(ip, target, 0, len) == (int)len ? 0 : -1;
+    iunlock(ip);
+  }
+  end_transaction();
+  if (ip) {
+    // 长目标只写进了延迟分配的脏页：立即回写分配块，之后 inode 可被回收
+    if (r == 0 && iflush(ip) < 0) r = -1;
+    iput(ip);
+  }
+  return r;
+}
+
+int readlink(const char *path, char *buf, int n) {
+  if (!path || !buf || n <= 0 || fs_dev < 0) return -1;
+  struct minode *ip = path_walk((char*)path);
+  if (!ip) return -1;
+  // 先读到栈上，放开 ilock 后再复制给调用者：buf 可能在映射窗口内（见 write）
+  char tmp[MYFS_SYMLINK_MAX];
+  if (n > MYFS_SYMLINK_MAX) n = MYFS_SYMLINK_MAX;
+  ilock(ip);
+  int r = MYFS_TYPE(ip->d.mode) == MYFT_SYMLINK ? readi(ip, tmp, 0, (uint32)n) : -1;
+  iunlockput(ip);
+  if (r > 0) memcpy(buf, tmp, r);
+  return r;
 }
 
 int unlink(const char *path) {
-  if (!path) return -1;
-  if (g_fake.exists && strncmp(g_fake.name, path, sizeof(g_fake.name)) == 0) {
-    g_fake.exists = 0;
-    g_fake.size = 0;
-    g_fake.name[0] = '\0';
-    return 0;
+  if (!path || fs_dev < 0) return -1;
+  char name[DIR_MAX_NAME + 1];
+  // 预留按文件的块分布计算：删除最后一个链接时在同一事务中截断并释放 inode
+  struct minode *target = path_walk((char*)path);
+  if (!target) return -1;
+  begin_transaction_n(FS_UNLINK_OPBLOCKS + iput_opblocks(target));
+  struct minode *dp = path_parent((char*)path, name);
+  if (!dp) {
+    iput(target);
+    end_transaction();
+    return -1;
   }
-  return -1;
-}
\ No newline at end of file
+  ilock(dp);
+  struct minode *ip = dir_lookup(dp, name, 0);
+  if (!ip || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+    if (ip) iput(ip);
+    iunlockput(dp);
+    iput(target);
+    end_transaction();
+    return -1;
+  }
+  ilock(ip);
+  if (MYFS_TYPE(ip->d.mode) == MYFT_DIR || dir_unlink(dp, name) < 0) {
+    iunlockput(ip);
+    iunlockput(dp);
+    iput(target);
+    end_transaction();
+    return -1;
+  }
+  iunlockput(dp);
+  ip->d.nlink--;
+  iupdate(ip);
+  // 最后一个引用释放时截断并释放 inode
+  iunlockput(ip);
+  iput(target);
+  end_transaction();
+  return 0;
+}
@@ -9,7 +9,7 @@
 #define LOG_SIZE 30
 
 #define MYFS_MAGIC 0x4D594653
-#define MYFS_VERSION 1
+#define MYFS_VERSION 2
 
 #define MYFS_NDIRECT 12
 #define MYFS_PTRS_PER_BLOCK (BLOCK_SIZE / 4)
@@ -53,19 +53,92 @@ struct inode {
   uint32 ctime;              // 状态变更时间（秒）
   uint32 flags;              // 标志位（目录索引、内联数据等开关）
   uint32 xattr;              // 扩展属性块指针（未启用为 0）
-  uint32 direct[MYFS_NDIRECT];// 直接块指针数组（快速定位小文件数据）
-  uint32 indirect;           // 一级间接块指针（块内为数据块号数组）
-  uint32 double_indirect;    // 二级间接块指针（指向若干一级间接块）
+  union {
+    struct {
+      uint32 direct[MYFS_NDIRECT];// 直接块指针数组（快速定位小文件数据）
+      uint32 indirect;           // 一级间接块指针（块内为数据块号数组）
+      uint32 double_indirect;    // 二级间接块指针（指向若干一级间接块）
+    };
+    uint32 i_block[MYFS_NDIRECT + 2]; // extent 映射时存放 extent 头与条目（见 MYFS_FL_EXTENTS）
+  };
   uint8 inline_data[128];    // 内联数据（极小文件或短符号链接）
 };
 
+// inode flags
+#define MYFS_FL_EXTENTS 0x1          // 数据块按 extent 映射，i_block 存放 extent 树根
+#define MYFS_FL_INDEX   0x2          // 目录按名字散列建立索引（htree），见 myfs_dx_header
+#define MYFS_FL_INLINE  0x4          // 数据存放在 inline_data 中，不占数据块（普通文件与符号链接）
+
+#define MYFS_INLINE_MAX  128         // inline_data 容量：更大的文件写入时转为按块存放
+#define MYFS_SYMLINK_MAX 255         // 符号链接目标的最大长度
+
+// extent：一段逻辑块连续且物理块连续的映射
+// 树根在 inode 的 i_block 中，至多 MYFS_EXT_INODE_MAX 项；depth>0 时节点中各项为索引，
+// pblk 指向下一层的树块（块首为 extent 头，其后至多 MYFS_EXT_LEAF_MAX 项），叶（depth=0）中为 extent，
+// 各层按 lblk 升序；树高至多 MYFS_EXT_MAX_DEPTH
+struct myfs_extent {
+  uint32 lblk;               // 起始逻辑块号
+  uint32 pblk;               // 起始物理块号（索引项中为下一层树块的块号）
+  uint32 len;                // 块数（索引项中未用）
+};
+
+struct myfs_extent_header {
+  uint16 magic;              // MYFS_EXT_MAGIC
+  uint16 entries;            // 有效项数
+  uint16 max;                // 本节点容量
+  uint16 depth;              // 0：项为 extent；>0：项为指向 depth-1 层树块的索引
+};
+
+#define MYFS_EXT_MAGIC     0xF30A
+#define MYFS_EXT_INODE_MAX ((sizeof(uint32) * (MYFS_NDIRECT + 2) - sizeof(struct myfs_extent_header)) / sizeof(struct myfs_extent))
+#define MYFS_EXT_LEAF_MAX  ((BLOCK_SIZE - sizeof(struct myfs_extent_header)) / sizeof(struct myfs_extent))
+#define MYFS_EXT_MAX_LEN   32768     // 单个 extent 的最大块数
+#define MYFS_EXT_MAX_DEPTH 3         // 树高上限：约 3*340*340*340 个 extent
+
+// 散列目录索引：目录块 0 依次为 "."、".." 与终止项（不识别索引的代码只看到这两项），
+// 从 MYFS_DX_ROOT_OFF 起为索引根；索引项按散列值升序，指向叶块（levels=0）或索引块（levels=1）。
+// 索引块以 8 字节的空目录项开头，其后为索引头与索引项；叶块是普通目录块
+struct myfs_dx_header {
+  uint32 magic;              // MYFS_DX_MAGIC
+  uint16 count;              // 有效索引项数
+  uint16 limit;              // 本节点容量
+  uint8  levels;             // 根下索引块层数（仅根中有效）：0 或 1
+  uint8  pad[3];
+};
+
+struct myfs_dx_entry {
+  uint32 hash;               // 该子树的散列下界（首项视为 0）
+  uint32 block;              // 目录内逻辑块号
+};
+
+#define MYFS_DX_MAGIC      0xD1C7
+#define MYFS_DX_ROOT_OFF   32
+#define MYFS_DX_NODE_OFF   8
+#define MYFS_DX_ROOT_LIMIT ((BLOCK_SIZE - MYFS_DX_ROOT_OFF - sizeof(struct myfs_dx_header)) / sizeof(struct myfs_dx_entry))
+#define MYFS_DX_NODE_LIMIT ((BLOCK_SIZE - MYFS_DX_NODE_OFF - sizeof(struct myfs_dx_header)) / sizeof(struct myfs_dx_entry))
+
+// 目录块由首尾相接的目录项组成，各项 rec_len 之和恰为 BLOCK_SIZE；
+// 一项的 rec_len 可大于自身所需长度，多出的部分即块内空闲空间。
+// 删除时并入前一项，块首项删除时只清零 ino，因此空闲空间总是合并在已有项之后
 struct dirent {
-  uint32 ino;                // 目录项对应的 inode 号
+  uint32 ino;                // 目录项对应的 inode 号，0 表示空闲
+  uint16 rec_len;            // 本项到下一项的距离（4 字节对齐）
+  uint8 name_len;            // 文件名长度（不含终止符）
   uint8 type;                // 文件类型（见 my_filetype）
-  uint16 name_len;           // 文件名长度（不含终止符）
   char name[];               // 变长文件名（柔性数组）
 };
 
+// 名字长为 n 的目录项所需的最小长度
+#define MYFS_DIRENT_LEN(n) ((uint)((sizeof(struct dirent) + (n) + 3) & ~3))
+
+// mode 高 4 位为文件类型（my_filetype），低 12 位为权限位
+#define MYFS_MODE(type, perm) ((uint16)(((type) << 12) | ((perm) & 0xfff)))
+#define MYFS_TYPE(mode) ((mode) >> 12)
+
+// 每个 inode 表块容纳的 inode 数，及 inode 号所在的表块
+#define MYFS_IPB ((uint32)(BLOCK_SIZE / sizeof(struct inode)))
+#define MYFS_IBLOCK(sb, inum) ((sb)->inode_table_start + (inum) / MYFS_IPB)
+
 #define MYFS_MAX_DIRECT (MYFS_NDIRECT)
 #define MYFS_MAX_INDIRECT (MYFS_PTRS_PER_BLOCK)
 #define MYFS_MAX_DOUBLE_INDIRECT (MYFS_PTRS_PER_BLOCK * MYFS_PTRS_PER_BLOCK)
@@ -78,10 +151,43 @@ struct dirent {
 #define O_RDWR   0x2
 #define O_RDONLY 0x4
 
-// 接口原型（最小实现由 fs.c 提供）
+// 每个位图块为一个分配组；挂载时为各组在内存中维护空闲计数
+#define FS_MAX_GROUPS 32
+
+// 延迟分配时为 extent 叶块等元数据保留的空闲块：空闲块数降到该值加未分配的脏页数时写入停止，
+// 因此写满磁盘后仍剩至多这么多空闲块
+#define FS_DELALLOC_SLACK 16
+
+// 格式化：在 dev 上建立 nblocks 块、ninodes 个 inode 的文件系统（仅含根目录），成功返回 0
+int fs_format(int dev, uint32 nblocks, uint32 ninodes);
+// 挂载：读取超级块、恢复日志并建立 inode 缓存，成功返回 0
+int fs_mount(int dev);
+// 复制已挂载文件系统的超级块（空闲计数为内存中的实时值），未挂载返回 -1
+int fs_superblock(struct superblock *out);
+
+// 位图分配器统计（分配次数、累计周期与扫描的 64 位字数）
+extern uint64 fs_balloc_count;
+extern uint64 fs_balloc_cycles;
+extern uint64 fs_ialloc_count;
+extern uint64 fs_ialloc_cycles;
+extern uint64 fs_bitmap_words;
+extern uint64 fs_delalloc_runs;
+extern uint64 fs_delalloc_blocks;
+
+// 接口原型（由 fs.c 提供）
 int open(const char *path, int flags);
 int write(int fd, const void *buf, int n);
 int read(int fd, void *buf, int n);
 int close(int fd);
+// 在内核中把 fd_in 当前偏移起的至多 n 字节复制到 fd_out 的当前偏移，两边偏移均推进；返回复制的字节数
+int copy_file_range(int fd_in, int fd_out, int n);
+// 同上，out_fd 还可以是控制台（console_open）
+int sendfile(int out_fd, int in_fd, int n);
 int unlink(const char *path);
+// 创建目录（父目录须已存在），路径已存在时返回 -1
+int mkdir(const char *path);
+// 在 path 处创建指向 target 的符号链接；open 时按从根开始的路径跟随
+int symlink(const char *target, const char *path);
+// 读取符号链接目标（不含终止符），返回长度，失败返回 -1
+int readlink(const char *path, char *buf, int n);
 #endif
\ No newline at end of file
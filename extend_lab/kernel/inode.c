@@ -0,0 +1,199 @@
+#include "types.h"
+#include "string.h"
+#include "printf.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "bcache.h"
+#include "log.h"
+#include "inode.h"
+#include "pagecache.h"
+
+static struct minode ipool[ICACHE_NINODE];
+static struct minode *ibuckets[ICACHE_NBUCKETS];
+static struct minode ilru;          // 空闲 LRU 哑元头：头部最近释放，尾部最久未用
+static struct spinlock icache_lock;
+
+// 已挂载文件系统
+static int ic_dev = -1;
+static struct superblock ic_sb;
+
+// 统计计数器
+uint64 icache_hits = 0;
+uint64 icache_misses = 0;
+
+static inline uint ihash(uint dev, uint32 inum) {
+  return (dev ^ inum) & (ICACHE_NBUCKETS - 1);
+}
+
+static void ilru_remove(struct minode *ip) {
+  ip->lru_prev->lru_next = ip->lru_next;
+  ip->lru_next->lru_prev = ip->lru_prev;
+  ip->lru_next = ip->lru_prev = 0;
+}
+
+static void ilru_insert_mru(struct minode *ip) {
+  ip->lru_next = ilru.lru_next;
+  ip->lru_prev = &ilru;
+  ilru.lru_next->lru_prev = ip;
+  ilru.lru_next = ip;
+}
+
+static void ihash_remove(struct minode *ip) {
+  struct minode **pp = &ibuckets[ihash(ip->dev, ip->inum)];
+  while (*pp) {
+    if (*pp == ip) {
+      *pp = ip->hnext;
+      ip->hnext = 0;
+      return;
+    }
+    pp = &(*pp)->hnext;
+  }
+}
+
+void iinit(int dev, struct superblock *sb) {
+  initlock(&icache_lock, "icache");
+  ilru.lru_next = ilru.lru_prev = &ilru;
+  for (int i = 0; i < ICACHE_NBUCKETS; i++) ibuckets[i] = 0;
+  for (int i = 0; i < ICACHE_NINODE; i++) {
+    struct minode *ip = &ipool[i];
+    memset(ip, 0, sizeof(*ip));
+    ilru_insert_mru(ip);
+  }
+  ic_dev = dev;
+  memcpy(&ic_sb, sb, sizeof(ic_sb));
+  icache_hits = 0;
+  icache_misses = 0;
+}
+
+struct minode* iget(uint dev, uint32 inum) {
+  acquire(&icache_lock);
+  for (struct minode *ip = ibuckets[ihash(dev, inum)]; ip; ip = ip->hnext) {
+    if (ip->dev == dev && ip->inum == inum) {
+      if (ip->ref == 0) ilru_remove(ip);
+      ip->ref++;
+      icache_hits++;
+      release(&icache_lock);
+      return ip;
+    }
+  }
+  // 未命中：复用最久未用的空闲 inode；仍有脏页的 inode 要等回写后才能复用，否则数据丢失
+  struct minode *ip = ilru.lru_prev;
+  while (ip != &ilru && ip->pc_ndirty > 0) ip = ip->lru_prev;
+  if (ip == &ilru) panic("iget: no inodes");
+  ilru_remove(ip);
+  ihash_remove(ip);
+  ip->dev = dev;
+  ip->inum = inum;
+  ip->ref = 1;
+  ip->valid = 0;
+  ip->dir_hint = 0;
+  ip->hnext = ibuckets[ihash(dev, inum)];
+  ibuckets[ihash(dev, inum)] = ip;
+  icache_misses++;
+  if (ip->pc_npages == 0) {
+    ip->locked = 0;
+    release(&icache_lock);
+    return ip;
+  }
+  // 旧 inode 的干净缓存页不再可达：在 icache_lock 之外丢弃，期间新身份的 ilock 等待
+  ip->locked = 1;
+  release(&icache_lock);
+  pcache_truncate(ip, 0);
+  acquire(&icache_lock);
+  ip->locked = 0;
+  wakeup(ip);
+  release(&icache_lock);
+  return ip;
+}
+
+struct minode* idup(struct minode *ip) {
+  acquire(&icache_lock);
+  ip->ref++;
+  release(&icache_lock);
+  return ip;
+}
+
+// 释放引用：最后一个引用释放且已无目录项指向时，截断并释放该 inode（此时调用者需处于事务中）
+void iput(struct minode *ip) {
+  if (!ip) return;
+  acquire(&icache_lock);
+  if (ip->ref <= 0) panic("iput");
+  if (ip->ref == 1 && ip->valid && ip->d.nlink == 0 && MYFS_TYPE(ip->d.mode) != MYFT_UNKNOWN) {
+    // 只有本引用：ilock 不会被争用
+    ip->locked = 1;
+    release(&icache_lock);
+    itrunc(ip);
+    ip->d.mode = 0;
+    iupdate(ip);
+    ifree(ip);
+    ip->valid = 0;
+    acquire(&icache_lock);
+    ip->locked = 0;
+    wakeup(ip);
+  }
+  ip->ref--;
+  if (ip->ref == 0) ilru_insert_mru(ip);
+  release(&icache_lock);
+}
+
+void ilock(struct minode *ip) {
+  if (!ip || ip->ref < 1) panic("ilock");
+  acquire(&icache_lock);
+  while (ip->locked) sleep(ip, &icache_lock);
+  ip->locked = 1;
+  release(&icache_lock);
+
+  if (ip->valid) return;
+  if (ip->inum >= ic_sb.inode_count) panic("ilock: bad inum");
+  struct buffer_head *bh = get_block(ip->dev, MYFS_IBLOCK(&ic_sb, ip->inum));
+  if (!bh || !bh->valid) panic("ilock: read inode table");
+  memcpy(&ip->d, bh->data + (ip->inum % MYFS_IPB) * sizeof(struct inode), sizeof(struct inode));
+  put_block(bh);
+  ip->valid = 1;
+}
+
+void iunlock(struct minode *ip) {
+  if (!ip || !ip->locked || ip->ref < 1) panic("iunlock");
+  acquire(&icache_lock);
+  ip->locked = 0;
+  wakeup(ip);
+  release(&icache_lock);
+}
+
+void iunlockput(struct minode *ip) {
+  iunlock(ip);
+  iput(ip);
+}
+
+void iupdate(struct minode *ip) {
+  struct buffer_head *bh = get_block(ip->dev, MYFS_IBLOCK(&ic_sb, ip->inum));
+  if (!bh || !bh->valid) {
+    printf("icache: update inode %d failed\n", ip->inum);
+    if (bh) put_block(bh);
+    return;
+  }
+  memcpy(bh->data + (ip->inum % MYFS_IPB) * sizeof(struct inode), &ip->d, sizeof(struct inode));
+  log_block_write(bh);
+  put_block(bh);
+}
+
+struct minode* iroot(void) {
+  if (ic_dev < 0) return 0;
+  return iget((uint)ic_dev, ic_sb.root_inode);
+}
+
+void icache_dump(void) {
+  acquire(&icache_lock);
+  int used = 0;
+  for (int i = 0; i < ICACHE_NINODE; i++) {
+    struct minode *ip = &ipool[i];
+    if (ip->ref == 0) continue;
+    used++;
+    printf("inode dev=%d inum=%d ref=%d type=%d nlink=%d size=%d\n", ip->dev, ip->inum, ip->ref,
+           ip->valid ? MYFS_TYPE(ip->d.mode) : -1, ip->d.nlink, ip->d.size);
+  }
+  printf("inodes in use: %d/%d, icache hits: %d misses: %d\n", used, ICACHE_NINODE,
+         (int)icache_hits, (int)icache_misses);
+  release(&icache_lock);
+}
@@ -0,0 +1,73 @@
+#ifndef INODE_H
+#define INODE_H
+
+#include "types.h"
+#include "fs.h"
+
+// inode 缓存：磁盘 inode 的内存副本，按 (dev, inum) 散列
+// 引用计数归零的 inode 仍保留有效副本并挂在 LRU 上，再次打开时无需访问块缓存
+#define ICACHE_NINODE   64   // 缓存的 inode 数量（固定大小池）
+#define ICACHE_NBUCKETS 64   // 哈希桶数量（2 的幂）
+
+// 内存 inode
+struct minode {
+  uint   dev;                // 设备号
+  uint32 inum;               // inode 号
+  int    ref;                // 引用计数：>0 表示正在被使用，不可替换
+  int    valid;              // d 是否已从 inode 表读入
+  int    locked;             // ilock 持有标志，等待者在该 inode 上睡眠
+  struct inode d;            // 磁盘 inode 副本
+  uint32 dir_hint;           // 线性目录中第一个可能有空位的块（仅内存中维护）
+  void  *pc_root;            // 文件页缓存的基数树根（见 pagecache.h）
+  int    pc_height;          // 基数树高度，0 表示空树
+  int    pc_npages;          // 树中的缓存页数
+  int    pc_ndirty;          // 其中的脏页数：不为 0 时 inode 不可被 iget 复用
+  struct minode *hnext;      // 哈希桶链表
+  struct minode *lru_next;   // 空闲 LRU 双向链（仅 ref==0 的 inode 在链上）
+  struct minode *lru_prev;
+};
+
+// 记录已挂载文件系统的设备与超级块（inode 表位置、根 inode 号），并清空缓存
+void iinit(int dev, struct superblock *sb);
+// 取得 (dev, inum) 的内存 inode 并增加引用，不读盘
+struct minode* iget(uint dev, uint32 inum);
+struct minode* idup(struct minode *ip);
+// 释放引用；引用归零后保留在缓存中，已无目录项的 inode 在此截断并释放
+void iput(struct minode *ip);
+// 加锁；副本无效时从 inode 表读入
+void ilock(struct minode *ip);
+void iunlock(struct minode *ip);
+void iunlockput(struct minode *ip);
+// 把内存副本写回 inode 表块（调用者持有 ilock 并处于事务中）
+void iupdate(struct minode *ip);
+// 根目录 inode（已引用），未挂载时返回 0
+struct minode* iroot(void);
+// 打印缓存中各 inode 的引用与类型
+void icache_dump(void);
+
+// 由 fs.c 提供：inode 分配与数据块映射（修改类操作需处于事务中，调用者持有 ilock）
+struct minode* ialloc(int type);                // 分配新 inode（已引用、未加锁）
+void ifree(struct minode *ip);                  // 在 inode 位图中释放
+uint32 balloc_near(uint32 goal);                // 分配清零的数据块，尽量靠近 goal，失败返回 0
+uint32 balloc_data(uint32 goal);                // 同上但不清零：文件数据块由页缓存整块写出
+void bfree(uint32 b);
+uint32 bmap(struct minode *ip, uint32 bn, int alloc); // 逻辑块号 -> 磁盘块号，空洞返回 0
+void itrunc(struct minode *ip);                 // 释放全部数据块
+// 放下最后一个引用释放已删除的 ip 时可能改动的块数（调用者持有引用，不持 ilock）
+int iput_opblocks(struct minode *ip);
+int readi(struct minode *ip, char *dst, uint32 off, uint32 n);
+int writei(struct minode *ip, const char *src, uint32 off, uint32 n);
+// 回写 ip 的全部脏页并分配延迟分配的块，每批一个事务（调用者不持有 ilock、不在事务中）
+int iflush(struct minode *ip);
+
+// 由 fs.c 提供：mmap 的文件页（调用者不持有 ilock）
+struct cpage;
+int imap_prepare(struct minode *ip);            // 检查可否映射，内联文件的数据先移入页缓存
+struct cpage* igetpage(struct minode *ip, uint32 index); // 已填充的第 index 页（已引用），越过文件末尾返回 0
+int idirtypage(struct minode *ip, struct cpage *pg);     // 经映射写入后置脏，空闲块不足以延迟分配时返回 -1
+
+// 统计计数器
+extern uint64 icache_hits;
+extern uint64 icache_misses;
+
+#endif
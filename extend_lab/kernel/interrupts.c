@@ -6,6 +6,8 @@
 #include "printf.h"
 #include "proc.h"
 #include "syscall.h"
+#include "mmap.h"
+#include "fs.h"
 
 static inline uint64 ctx_read64(void *sp, int offset){ return *(uint64*)((char*)sp + offset); }
 static inline void   ctx_write64(void *sp, int offset, uint64 val){ *(uint64*)((char*)sp + offset) = val; }
@@ -117,12 +119,34 @@ void handle_instruction_page_fault(uint64 sepc, uint64 stval) {
   panic("Instruction page fault");
 }
 
+// 映射区内的缺页建立页表项后返回，重新执行访存指令
+// 缺页处理可能睡眠（ilock、读盘），期间其他陷入会改写 sepc/sstatus，返回前恢复
+// 当前进程映射窗口内无法处理的缺页（越界访问或内存耗尽）终止该进程，不使内核崩溃
+// 文件系统不在持有 ilock 或事务时访问映射窗口（read/write 经内核页中转）；
+// 事务中的进程若被终止，日志永远等不到它结束，此时只能按内核错误处理
+static int page_fault_mapped(uint64 sepc, uint64 stval, int write) {
+  uint64 sstatus = r_sstatus();
+  if (mmap_fault(stval, write) < 0) {
+    struct proc *p = get_current_process();
+    if (p && p->tx.reserved == 0 && stval >= p->mmap_base && stval < p->mmap_base + MMAP_WINDOW) {
+      printf("pid %d: unhandled %s fault at %p, killed\n", p->pid, write ? "store" : "load", stval);
+      exit_process(-1);
+    }
+    return 0;
+  }
+  w_sstatus(sstatus);
+  w_sepc(sepc);
+  return 1;
+}
+
 void handle_load_page_fault(uint64 sepc, uint64 stval) {
+  if (page_fault_mapped(sepc, stval, 0)) return;
   printf("Load page fault: sepc=%p stval=%p\n", sepc, stval);
   panic("Load page fault");
 }
 
 void handle_store_page_fault(uint64 sepc, uint64 stval) {
+  if (page_fault_mapped(sepc, stval, 1)) return;
   printf("Store page fault: sepc=%p stval=%p\n", sepc, stval);
   panic("Store page fault");
 }
@@ -175,6 +199,8 @@ void trap_handler(uint64 scause, uint64 sepc, uint64 stval,void *ctx_sp){
     // Exception: syscall / faults
     uint64 code = scause & ((1ULL<<63)-1);
     if(code == EXC_ECALL_U || code == EXC_ECALL_S){
+      // mmap/munmap 与文件复制可能睡眠，返回前恢复 sstatus
+      uint64 sstatus = r_sstatus();
       // 读取 syscall 号与参数
       uint64 num = ctx_read64(ctx_sp, CTX_OFF_A7);
       uint64 a0  = ctx_read64(ctx_sp, CTX_OFF_A0);
@@ -205,6 +231,24 @@ void trap_handler(uint64 scause, uint64 sepc, uint64 stval,void *ctx_sp){
           uint64 a2 = ctx_read64(ctx_sp, CTX_OFF_A2);
           ret = (uint64)sys_write((int)a0, (const char*)a1, (int)a2);
           break; }
+        case SYS_mmap: {
+          uint64 a2 = ctx_read64(ctx_sp, CTX_OFF_A2);
+          uint64 a3 = ctx_read64(ctx_sp, CTX_OFF_A3);
+          uint64 a4 = ctx_read64(ctx_sp, CTX_OFF_A4);
+          uint64 a5 = ctx_read64(ctx_sp, CTX_OFF_A5);
+          ret = mmap(a0, a1, (int)a2, (int)a3, (int)a4, (uint32)a5);
+          break; }
+        case SYS_munmap:
+          ret = (uint64)munmap(a0, a1);
+          break;
+        case SYS_sendfile: {
+          uint64 a2 = ctx_read64(ctx_sp, CTX_OFF_A2);
+          ret = (uint64)sendfile((int)a0, (int)a1, (int)a2);
+          break; }
+        case SYS_copy_file_range: {
+          uint64 a2 = ctx_read64(ctx_sp, CTX_OFF_A2);
+          ret = (uint64)copy_file_range((int)a0, (int)a1, (int)a2);
+          break; }
         default:
           printf("syscall: unknown num=%p sepc=%p\n", (void*)num, (void*)sepc);
           ret = (uint64)-1;
@@ -212,6 +256,7 @@ void trap_handler(uint64 scause, uint64 sepc, uint64 stval,void *ctx_sp){
       }
       // 写回返回值并推进 sepc 跳过 ecall
       ctx_write64(ctx_sp, CTX_OFF_A0, ret);
+      w_sstatus(sstatus);
       w_sepc(sepc + 4);
     } else {
       handle_exception(scause, sepc, stval);
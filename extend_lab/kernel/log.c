@@ -5,219 +5,657 @@
 #include "bcache.h"
 #include "fs.h"
 #include "log.h"
+#include "timer.h"
+#include "proc.h"
+#include "blkdev.h"
 
 static struct log_state g_log;
 
-// 将内存中的日志头写入日志起始块
-static void write_log_header(void) {
-  struct buffer_head *hdr = get_block(g_log.dev, (uint)g_log.start);
-  if (!hdr) { printf("log: cannot get header block\n"); return; }
-  struct log_header lh;
-  memset(&lh, 0, sizeof(lh));
-  lh.n = g_log.n;
-  for (int i = 0; i < g_log.n && i < LOG_MAX_BLOCKS; i++) {
-    lh.block[i] = g_log.block[i];
+// 尚无进程时（启动阶段）的事务记账
+static struct log_tx boot_tx;
+
+// 后台提交线程
+static int committer_pid = 0;
+static int commit_chan_var = 0;
+static void *commit_chan = &commit_chan_var;
+
+// 后台检查点线程
+static int ckpt_pid = 0;
+static int ckpt_chan_var = 0;
+static void *ckpt_chan = &ckpt_chan_var;
+static int ckpt_wanted = 0;        // 有事务在等待循环区空间
+
+// 统计计数器
+uint64 log_commits = 0;
+uint64 log_group_trans = 0;
+uint64 log_checkpoints = 0;
+uint64 log_ckpt_trans = 0;
+
+// 提交与检查点/恢复各自的暂存区：每块一项，放在栈上会超出内核栈
+static uint32 commit_crc[LOG_MAX_BLOCKS];
+static uint32 commit_slot[1 + LOG_MAX_BLOCKS];
+static char *commit_io[1 + LOG_MAX_BLOCKS];
+static char commit_hdr[BLOCK_SIZE];
+static uint32 rec_block[LOG_MAX_BLOCKS];
+static uint32 rec_crc[LOG_MAX_BLOCKS];
+static char rec_data[BLOCK_SIZE];
+
+// 冻结副本：提交时把每个记录的块复制一份，日志与检查点都只写这份副本
+// 缓存中的块提交后仍会被后续事务修改并吸收进未提交的组，不能直接写回原位
+// 每个块只保留最近一次提交的副本（LIVE）；较早的记录检查点时跳过已被取代的块
+// 副本总数不超过已提交未检查点的块数与当前组之和，即 LOG_PIN_MAX
+#define FROZEN_FREE   0
+#define FROZEN_COMMIT 1              // 所属提交正在写日志
+#define FROZEN_LIVE   2              // 该块最近一次已提交的内容
+#define FROZEN_CKPT   3              // 检查点正在写回原位
+struct log_frozen {
+  int state;
+  uint32 block;
+  uint32 seq;                        // 所属提交的序号
+};
+static struct log_frozen frozen[LOG_PIN_MAX];
+static char frozen_data[LOG_PIN_MAX][BLOCK_SIZE];
+static int commit_frozen[LOG_PIN_MAX];   // 当前提交各块对应的副本下标
+static uint32 ckpt_block[LOG_PIN_MAX];
+static char *ckpt_io[LOG_PIN_MAX];
+static int ckpt_frozen[LOG_PIN_MAX];
+
+// 循环区槽位数（超级块之后的全部块）
+static int log_ring(void) {
+  return g_log.size - 1;
+}
+
+// 一个事务组可容纳的数据块数：提交记录与数据块都需放入循环区
+int log_capacity(void) {
+  int cap = log_ring() - 1;
+  if (cap > LOG_MAX_BLOCKS) cap = LOG_MAX_BLOCKS;
+  return cap;
+}
+
+// 记录 n 个数据块占用的槽位数
+static int log_slots(int n) {
+  return 1 + n;
+}
+
+// 循环区剩余槽位（调用者持有 g_log.lock）
+static int log_free(void) {
+  return log_ring() - (int)(g_log.head - g_log.tail);
+}
+
+// 槽位计数对应的块号
+static uint32 log_slot_block(uint32 pos) {
+  return (uint32)g_log.start + 1 + pos % (uint32)log_ring();
+}
+
+static uint32 crc32c_table[256];
+static int crc32c_ready = 0;
+
+uint32 crc32c(uint32 crc, const void *buf, uint32 len) {
+  if (!crc32c_ready) {
+    for (uint32 i = 0; i < 256; i++) {
+      uint32 c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+      crc32c_table[i] = c;
+    }
+    crc32c_ready = 1;
   }
-  memcpy(hdr->data, &lh, sizeof(lh));
-  hdr->dirty = 1;
-  sync_block(hdr);
-  put_block(hdr);
+  const unsigned char *p = (const unsigned char*)buf;
+  crc = ~crc;
+  for (uint32 i = 0; i < len; i++) crc = crc32c_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
 }
 
-// 清空日志头（n=0），表示日志区为空
-static void clear_log_header(void) {
-  g_log.n = 0;
-  write_log_header();
-}
-
-// 将要提交的数据块复制到日志区的数据块中（start+1..start+n）
-static int write_log_data(void) {
-  for (int i = 0; i < g_log.n; i++) {
-    uint32 target_bno = g_log.block[i];
-    // 获取源数据（目标块的最新内容）
-    struct buffer_head *src = get_block(g_log.dev, (uint)target_bno);
-    if (!src || !src->valid) {
-      if (src) put_block(src);
-      printf("log: read target block failed dev=%d blk=%u\n", g_log.dev, target_bno);
+uint32 log_commit_checksum(uint32 seq, uint32 n, const uint32 *blocks, const uint32 *bcrc) {
+  uint32 crc = crc32c(0, &seq, sizeof(seq));
+  crc = crc32c(crc, &n, sizeof(n));
+  crc = crc32c(crc, blocks, n * sizeof(uint32));
+  return crc32c(crc, bcrc, n * sizeof(uint32));
+}
+
+static struct log_tx *cur_tx(void) {
+  struct proc *p = get_current_process();
+  return p ? &p->tx : &boot_tx;
+}
+
+// 块号哈希（乘法散列取高 LOG_HASH_BITS 位）
+static uint32 log_hash(uint32 block) {
+  return (block * 2654435761u) >> (32 - LOG_HASH_BITS);
+}
+
+// 查找块号，存在则返回其在 block[] 中的下标，否则返回 -1 并把 *slot 置为可插入的空槽
+// （调用者持有 g_log.lock）
+static int log_hash_find(uint32 block, uint32 *slot) {
+  uint32 h = log_hash(block);
+  for (;;) {
+    uint16 v = g_log.hash[h];
+    if (v == 0) {
+      *slot = h;
       return -1;
     }
+    if (g_log.block[v - 1] == block) return v - 1;
+    h = (h + 1) & (LOG_HASH_SIZE - 1);
+  }
+}
 
-    // 获取日志区对应数据块
-    uint32 log_bno = (uint32)(g_log.start + 1 + i);
-    struct buffer_head *dst = get_block(g_log.dev, (uint)log_bno);
-    if (!dst) {
-      put_block(src);
-      printf("log: get log block failed dev=%d blk=%u\n", g_log.dev, log_bno);
-      return -1;
+// 取一个空闲副本给块 block（调用者持有 g_log.lock）
+static int frozen_alloc(uint32 block) {
+  for (int i = 0; i < LOG_PIN_MAX; i++) {
+    if (frozen[i].state != FROZEN_FREE) continue;
+    frozen[i].state = FROZEN_COMMIT;
+    frozen[i].block = block;
+    frozen[i].seq = 0;
+    return i;
+  }
+  panic("log: out of frozen copies");
+  return -1;
+}
+
+// 查找块 block 处于 state 的副本，不存在返回 -1（调用者持有 g_log.lock）
+static int frozen_find(uint32 block, int state) {
+  for (int i = 0; i < LOG_PIN_MAX; i++)
+    if (frozen[i].state == state && frozen[i].block == block) return i;
+  return -1;
+}
+
+// 提交写出后登记本次的副本：成功则取代各块较早的副本，失败则丢弃（调用者持有 g_log.lock）
+static void frozen_install(int n, uint32 seq, int ok) {
+  for (int i = 0; i < n; i++) {
+    struct log_frozen *f = &frozen[commit_frozen[i]];
+    if (!ok) {
+      f->state = FROZEN_FREE;
+      continue;
     }
+    int old = frozen_find(f->block, FROZEN_LIVE);
+    if (old >= 0) frozen[old].state = FROZEN_FREE;
+    f->state = FROZEN_LIVE;
+    f->seq = seq;
+  }
+}
+
+// 循环区槽位 pos 起 cnt 个槽位对应的块号（可跨越回绕）
+static void log_slot_list(uint32 pos, int cnt, uint32 *out) {
+  for (int i = 0; i < cnt; i++) out[i] = log_slot_block(pos + (uint32)i);
+}
+
+// 绕过缓存读入槽位 pos 处的一个日志块：日志块只经直接 I/O 访问，不占缓存
+static int log_read_slot(uint32 pos, char *buf) {
+  uint32 b = log_slot_block(pos);
+  return bcache_direct_io((uint)g_log.dev, BLK_READ, &b, &buf, 1);
+}
+
+// 写日志超级块：记录尾部事务的位置与序号
+static void write_log_super(uint32 tail, uint32 tail_seq) {
+  struct buffer_head *sbh = get_block(g_log.dev, (uint)g_log.start);
+  if (!sbh) { printf("log: cannot get log super block\n"); return; }
+  struct log_super ls;
+  memset(&ls, 0, sizeof(ls));
+  ls.magic = LOG_SB_MAGIC;
+  ls.tail = tail % (uint32)log_ring();
+  ls.tail_seq = tail_seq;
+  memset(sbh->data, 0, BLOCK_SIZE);
+  memcpy(sbh->data, &ls, sizeof(ls));
+  sbh->dirty = 1;
+  sync_block(sbh);
+  put_block(sbh);
+}
+
+// 填写提交记录
+static void fill_header(char *data, int n, uint32 seq, uint32 checksum) {
+  memset(data, 0, BLOCK_SIZE);
+  struct log_header *lh = (struct log_header*)data;
+  lh->magic = LOG_MAGIC;
+  lh->seq = seq;
+  lh->n = (uint32)n;
+  lh->checksum = checksum;
+  memcpy(lh->block, g_log.block, (uint64)n * sizeof(uint32));
+}
 
-    memcpy(dst->data, src->data, BLOCK_SIZE);
-    dst->dirty = 1;
-    sync_block(dst);
-    put_block(dst);
-    put_block(src);
+// 在循环区槽位 pos 处写出提交记录与 n 个日志数据块
+// 提交期间没有进行中的事务，先把各块冻结到 commit_frozen 指向的副本，日志从副本写出；
+// 记录与数据块一起提交、一次派发，校验和覆盖全部数据块，任意写出顺序下崩溃都能识别不完整的提交
+// 源块不标脏：原位只由检查点从副本写回，回写线程与替换都不会把未提交的修改写出
+static int write_log_commit(uint32 pos) {
+  int n = g_log.n;
+  for (int i = 0; i < n; i++) {
+    char *copy = frozen_data[commit_frozen[i]];
+    memcpy(copy, g_log.buf[i]->data, BLOCK_SIZE);
+    commit_crc[i] = crc32c(0, copy, BLOCK_SIZE);
   }
+  uint32 seq = g_log.seq + 1;
+  uint32 checksum = log_commit_checksum(seq, (uint32)n, g_log.block, commit_crc);
+  fill_header(commit_hdr, n, seq, checksum);
+  commit_io[0] = commit_hdr;
+  for (int i = 0; i < n; i++) commit_io[1 + i] = frozen_data[commit_frozen[i]];
+  log_slot_list(pos, 1 + n, commit_slot);
+  if (bcache_direct_io((uint)g_log.dev, BLK_WRITE, commit_slot, commit_io, 1 + n) < 0)
+    return -1;
+
+  g_log.seq = seq;
   return 0;
 }
 
-// 将日志数据应用到目标块（home blocks），确保持久化
-static int install_trans(void) {
-  for (int i = 0; i < g_log.n; i++) {
-    uint32 target_bno = g_log.block[i];
-    uint32 log_bno = (uint32)(g_log.start + 1 + i);
+// 恢复时从槽位 data_pos 起的日志数据块安装 n 个目标块
+// 日志块直接读入目标块缓冲；目标块一起提交，由请求层按块号排序并合并相邻写
+static int install_blocks(uint32 data_pos, const uint32 *targets, int n) {
+  struct buffer_head *dst[LOG_IO_BATCH];
+  uint32 slots[LOG_IO_BATCH];
+  char *bufs[LOG_IO_BATCH];
+  for (int base = 0; base < n; base += LOG_IO_BATCH) {
+    int cnt = n - base;
+    if (cnt > LOG_IO_BATCH) cnt = LOG_IO_BATCH;
 
-    // 读出日志数据块
-    struct buffer_head *logbh = get_block(g_log.dev, (uint)log_bno);
-    if (!logbh || !logbh->valid) {
-      if (logbh) put_block(logbh);
-      printf("log: install read log block failed dev=%d blk=%u\n", g_log.dev, log_bno);
-      return -1;
+    int got = 0;
+    for (int i = 0; i < cnt; i++) {
+      dst[i] = get_block(g_log.dev, (uint)targets[base + i]);
+      if (!dst[i]) break;
+      bufs[i] = dst[i]->data;
+      got++;
     }
-
-    // 写入目标块
-    struct buffer_head *dst = get_block(g_log.dev, (uint)target_bno);
-    if (!dst) {
-      put_block(logbh);
-      printf("log: install get target block failed dev=%d blk=%u\n", g_log.dev, target_bno);
+    log_slot_list(data_pos + (uint32)base, got, slots);
+    int err = got < cnt || bcache_direct_io((uint)g_log.dev, BLK_READ, slots, bufs, got) < 0;
+    if (!err) {
+      for (int i = 0; i < got; i++) {
+        dst[i]->valid = 1;
+        dst[i]->dirty = 1;
+      }
+      sync_blocks(dst, got);
+    }
+    put_blocks(dst, got);
+    if (err) {
+      printf("log: install target block failed dev=%d blk=%d\n", g_log.dev, targets[base + got]);
       return -1;
     }
-
-    memcpy(dst->data, logbh->data, BLOCK_SIZE);
-    dst->dirty = 1;
-    sync_block(dst);
-
-    put_block(dst);
-    put_block(logbh);
   }
   return 0;
 }
 
 void log_init(int dev, struct superblock *sb) {
+  if (LOG_HASH_SIZE < 2 * LOG_MAX_BLOCKS) panic("log: LOG_HASH_BITS too small for LOG_MAX_BLOCKS");
   initlock(&g_log.lock, "log");
   g_log.start = (int)sb->log_start;
   g_log.size = (int)sb->log_size;
   g_log.outstanding = 0;
+  g_log.reserved = 0;
   g_log.committing = 0;
+  g_log.checkpointing = 0;
   g_log.dev = dev;
   g_log.n = 0;
+  g_log.npinned = 0;
+  memset(g_log.hash, 0, sizeof(g_log.hash));
+  g_log.head = 0;
+  g_log.tail = 0;
+  g_log.seq = 0;
+  g_log.tail_seq = 1;
+  g_log.group_start = 0;
+  g_log.ntrans = 0;
+  ckpt_wanted = 0;
+  memset(frozen, 0, sizeof(frozen));
 
   // 恢复可能遗留的事务
   recover_log();
   printf("log: init start=%d size=%d dev=%d\n", g_log.start, g_log.size, g_log.dev);
+  log_commit_start();
 }
 
-void begin_transaction(void) {
+// 把当前组写入循环区（提交），返回占用的槽位数，失败返回 -1
+// 写回原位留给检查点，提交者不再等待安装
+static int commit_transaction(uint32 pos) {
+  if (write_log_commit(pos) < 0) {
+    printf("log: write commit failed\n");
+    return -1;
+  }
+  int used = log_slots(g_log.n);
+  // 重置缓冲的块集合与吸收哈希表
+  g_log.n = 0;
+  memset(g_log.hash, 0, sizeof(g_log.hash));
+  return used;
+}
+
+// 是否应当检查点：循环区用量或固定块数过半（调用者持有 g_log.lock）
+static int ckpt_pressure(void) {
+  return (int)(g_log.head - g_log.tail) * 100 >= log_ring() * LOG_CKPT_HIGH_PCT ||
+         g_log.npinned * 100 >= LOG_PIN_MAX * LOG_CKPT_HIGH_PCT;
+}
+
+// 当前组是否应当提交（调用者持有 g_log.lock）
+// 无未结束事务时：未启动提交线程则立即提交；否则等日志接近满或等待超时
+static int group_ready(void) {
+  if (g_log.committing || g_log.outstanding > 0 || g_log.n == 0) return 0;
+  if (committer_pid <= 0) return 1;
+  if (g_log.n * 100 >= log_capacity() * LOG_GROUP_HIGH_PCT) return 1;
+  return timer_ticks() - g_log.group_start >= LOG_COMMIT_DELAY;
+}
+
+// 提交当前组（调用者持有 g_log.lock，返回时仍持有）
+// 准入检查保证当前组总能放入循环区剩余空间
+static void commit_locked(void) {
+  g_log.committing = 1;
+  int ntrans = g_log.ntrans;
+  int n = g_log.n;
+  uint32 pos = g_log.head;
+  for (int i = 0; i < n; i++) commit_frozen[i] = frozen_alloc(g_log.block[i]);
+  release(&g_log.lock);
+
+  int used = commit_transaction(pos);
+
   acquire(&g_log.lock);
-  while (g_log.committing) {
-    // 简化：忙等直到提交完成
-    release(&g_log.lock);
-    // 主动让出（若有调度器）；此处简单重新获取
-    acquire(&g_log.lock);
+  g_log.committing = 0;
+  frozen_install(n, g_log.seq, used > 0);
+  if (used > 0) {
+    g_log.head += (uint32)used;
+    g_log.npinned += n;
+    g_log.ntrans = 0;
+    log_commits++;
+    log_group_trans += (uint64)ntrans;
+    // 循环区或固定块用量过半：唤醒检查点线程提前腾出空间
+    if (ckpt_pressure() && ckpt_pid > 0) wakeup(ckpt_chan);
+  }
+  wakeup(&g_log);
+}
+
+void begin_transaction_n(int maxblocks) {
+  if (maxblocks <= 0 || maxblocks > log_capacity()) panic("log: too big a transaction");
+  acquire(&g_log.lock);
+  for (;;) {
+    if (g_log.committing) {
+      // 提交进行中：睡眠等待提交完成
+      sleep(&g_log, &g_log.lock);
+      continue;
+    }
+    // 已记录块、其他事务的预留与本次预留之和不超过单组容量才能开始
+    if (g_log.n + g_log.reserved + maxblocks > log_capacity()) {
+      if (g_log.outstanding == 0) {
+        // 无进行中事务：直接提交已累积的组
+        commit_locked();
+      } else {
+        // 等待进行中的事务结束
+        sleep(&g_log, &g_log.lock);
+      }
+      continue;
+    }
+    // 循环区回绕到尾部或固定块达到上限：等待检查点释放已提交事务占用的槽位与缓存块
+    int want = g_log.n + g_log.reserved + maxblocks;
+    if (log_slots(want) > log_free() || g_log.npinned + want > LOG_PIN_MAX) {
+      if (ckpt_pid > 0) {
+        ckpt_wanted = 1;
+        wakeup(ckpt_chan);
+        sleep(&g_log, &g_log.lock);
+      } else {
+        release(&g_log.lock);
+        log_checkpoint();
+        acquire(&g_log.lock);
+      }
+      continue;
+    }
+    break;
   }
   g_log.outstanding++;
+  g_log.reserved += maxblocks;
+  struct log_tx *tx = cur_tx();
+  tx->reserved = maxblocks;
+  tx->nblocks = 0;
   release(&g_log.lock);
 }
 
-static void commit_transaction(void) {
-  // 写日志数据
-  if (write_log_data() < 0) {
-    printf("log: write_log_data failed\n");
-    return;
-  }
-  // 写提交头（幂等性保障）
-  write_log_header();
-  // 安装事务到 home blocks
-  if (install_trans() < 0) {
-    printf("log: install_trans failed\n");
-  }
-  // 清空日志头
-  clear_log_header();
-  // 重置缓冲的块集合
-  g_log.n = 0;
+void begin_transaction(void) {
+  begin_transaction_n(LOG_OP_MAXBLOCKS);
 }
 
 void end_transaction(void) {
   acquire(&g_log.lock);
+  cur_tx()->reserved = 0;
   g_log.outstanding--;
   if (g_log.outstanding < 0) {
     printf("log: negative outstanding\n");
     g_log.outstanding = 0;
   }
+  if (g_log.n > 0) g_log.ntrans++;
+  // 已结束事务的预留在全部事务结束前保守保留；其记录的块已计入 n
+  if (g_log.outstanding == 0) g_log.reserved = 0;
 
-  if (g_log.committing) {
-    // 已在提交，直接返回
-    release(&g_log.lock);
-    return;
+  // 组提交：接近满或等待超时才提交，否则留给后续事务或提交线程
+  if (group_ready()) commit_locked();
+  // 预留释放或提交完成后，唤醒等待空间的事务
+  wakeup(&g_log);
+  release(&g_log.lock);
+}
+
+void log_force(void) {
+  acquire(&g_log.lock);
+  while (g_log.committing) sleep(&g_log, &g_log.lock);
+  if (g_log.outstanding == 0 && g_log.n > 0) commit_locked();
+  release(&g_log.lock);
+}
+
+// 读取槽位 pos 处序号为 seq 的提交记录，目标块号收集到 rec_block
+// 返回数据块数，记录无效返回 -1（调用者持有检查点或恢复的独占权）
+static int read_record(uint32 pos, uint32 seq, uint32 *checksum) {
+  if (log_read_slot(pos, rec_data) < 0) return -1;
+  struct log_header *lh = (struct log_header*)rec_data;
+  int n = (int)lh->n;
+  if (lh->magic != LOG_MAGIC || lh->seq != seq || n <= 0 || n > log_capacity()) return -1;
+  *checksum = lh->checksum;
+  memcpy(rec_block, lh->block, (uint64)n * sizeof(uint32));
+  return n;
+}
+
+// 把序号为 seq 的记录中仍为最近提交的块从冻结副本写回原位，成功返回 0
+// 被后续记录取代的块留给那条记录；副本写出期间标为 CKPT，新的提交不会取代或复用它
+static int checkpoint_record(int n, uint32 seq) {
+  int k = 0;
+  acquire(&g_log.lock);
+  for (int i = 0; i < n; i++) {
+    int f = frozen_find(rec_block[i], FROZEN_LIVE);
+    if (f < 0 || frozen[f].seq != seq) continue;
+    frozen[f].state = FROZEN_CKPT;
+    ckpt_frozen[k] = f;
+    ckpt_block[k] = rec_block[i];
+    ckpt_io[k] = frozen_data[f];
+    k++;
   }
+  release(&g_log.lock);
+
+  int err = bcache_write_home((uint)g_log.dev, ckpt_block, ckpt_io, k) < 0;
 
-  // 若没有正在进行的事务且存在待提交的块，则提交
-  if (g_log.outstanding == 0 && g_log.n > 0) {
-    g_log.committing = 1;
+  acquire(&g_log.lock);
+  for (int i = 0; i < k; i++) {
+    struct log_frozen *f = &frozen[ckpt_frozen[i]];
+    // 写回失败：副本仍是最近提交的内容时恢复为 LIVE，下次检查点重试
+    if (err && frozen_find(f->block, FROZEN_LIVE) < 0) f->state = FROZEN_LIVE;
+    else f->state = FROZEN_FREE;
+  }
+  release(&g_log.lock);
+  return err ? -1 : 0;
+}
+
+// 检查点：按提交顺序把尾部起的已提交事务写回原位，全部落盘后推进尾指针并写一次超级块
+// 原位从提交时的冻结副本写回；缓存块自写入事务起固定，写回后解除固定
+void log_checkpoint(void) {
+  acquire(&g_log.lock);
+  while (g_log.checkpointing) sleep(&g_log, &g_log.lock);
+  if (g_log.tail == g_log.head) {
+    ckpt_wanted = 0;
     release(&g_log.lock);
+    return;
+  }
+  g_log.checkpointing = 1;
+  ckpt_wanted = 0;
+  uint32 t = g_log.tail;
+  uint32 h = g_log.head;
+  uint32 seq = g_log.tail_seq;
+  release(&g_log.lock);
 
-    commit_transaction();
+  int ntx = 0;
+  int unpinned = 0;
+  while (t != h) {
+    uint32 checksum;
+    int n = read_record(t, seq, &checksum);
+    if (n < 0) {
+      printf("log: checkpoint found bad record slot=%d seq=%d\n", t % (uint32)log_ring(), seq);
+      break;
+    }
+    if (checkpoint_record(n, seq) < 0) break;
+    unpin_block_list((uint)g_log.dev, rec_block, n);
+    unpinned += n;
+    t += (uint32)log_slots(n);
+    seq++;
+    ntx++;
+  }
+  if (ntx > 0) write_log_super(t, seq);
 
-    acquire(&g_log.lock);
-    g_log.committing = 0;
+  acquire(&g_log.lock);
+  g_log.tail = t;
+  g_log.tail_seq = seq;
+  g_log.npinned -= unpinned;
+  g_log.checkpointing = 0;
+  if (ntx > 0) {
+    log_checkpoints++;
+    log_ckpt_trans += (uint64)ntx;
   }
+  wakeup(&g_log);
   release(&g_log.lock);
 }
 
-// 记录某个块的写操作（加入待提交集合，去重）
+// 提交线程：被时钟唤醒后提交超时的事务组
+static void log_committer(void) {
+  acquire(&g_log.lock);
+  for (;;) {
+    if (group_ready()) {
+      commit_locked();
+      continue;
+    }
+    sleep(commit_chan, &g_log.lock);
+  }
+}
+
+// 检查点线程：循环区或固定块用量过半、或有事务等待空间时，在后台写回已提交事务
+static void log_checkpointer(void) {
+  acquire(&g_log.lock);
+  for (;;) {
+    if (!g_log.checkpointing && g_log.head != g_log.tail && (ckpt_wanted || ckpt_pressure())) {
+      release(&g_log.lock);
+      log_checkpoint();
+      acquire(&g_log.lock);
+      continue;
+    }
+    sleep(ckpt_chan, &g_log.lock);
+  }
+}
+
+void log_commit_start(void) {
+  if (committer_pid <= 0) {
+    committer_pid = create_process_named(log_committer, "logcommit");
+    if (committer_pid < 0) {
+      printf("log: cannot start committer\n");
+      committer_pid = 0;
+    }
+  }
+  if (ckpt_pid <= 0) {
+    ckpt_pid = create_process_named(log_checkpointer, "logckpt");
+    if (ckpt_pid < 0) {
+      printf("log: cannot start checkpointer\n");
+      ckpt_pid = 0;
+    }
+  }
+}
+
+// 时钟中断上下文调用：不取 g_log.lock，仅在组等待超时时唤醒
+void log_on_tick(void) {
+  if (committer_pid <= 0 || g_log.n == 0 || g_log.outstanding > 0 || g_log.committing) return;
+  if (timer_ticks() - g_log.group_start >= LOG_COMMIT_DELAY) wakeup(commit_chan);
+}
+
+// 记录某个块的写操作（加入待提交集合，去重并固定其缓存块）
 void log_block_write(struct buffer_head *bh) {
   if (!bh) return;
   acquire(&g_log.lock);
-  // 简易处理：防止日志超额
-  if (g_log.n >= (g_log.size - 1) || g_log.n >= LOG_MAX_BLOCKS) {
-    // 日志满：此事务将持续积压，等待 end_transaction 提交
-    // 也可扩展为：主动提交当前日志（需要约束 begin/end 的语义）
-    printf("log: full, block ignored dev=%d blk=%u\n", g_log.dev, bh->block_num);
+  struct log_tx *tx = cur_tx();
+  if (g_log.outstanding < 1 || tx->reserved == 0) panic("log: write outside of transaction");
+  // 吸收：同一块在组内只记录一次，哈希查找 O(1)
+  uint32 slot;
+  if (log_hash_find(bh->block_num, &slot) >= 0) {
     release(&g_log.lock);
     return;
   }
-  // 去重
-  for (int i = 0; i < g_log.n; i++) {
-    if (g_log.block[i] == bh->block_num) {
-      release(&g_log.lock);
-      return;
-    }
+  // 新记入的块不得超过本事务的预留：超出会挤占其他事务的预留，最终溢出单组容量
+  if (++tx->nblocks > tx->reserved) {
+    printf("log: transaction reserved %d blocks, writing block %d as #%d\n", tx->reserved,
+           bh->block_num, tx->nblocks);
+    panic("log: transaction overran its reservation");
   }
-  g_log.block[g_log.n++] = bh->block_num;
+  if (g_log.n >= log_capacity()) panic("log: too big a transaction");
+  if (g_log.n == 0) g_log.group_start = timer_ticks();
+  // 固定在缓存中直到检查点：读者总能在缓存中看到最新内容，原位写回使用提交时的冻结副本
+  // pin_block 同时清除脏位；组内再次写入（吸收）时块已固定，回写路径一律跳过
+  pin_block(bh);
+  g_log.buf[g_log.n] = bh;
+  g_log.block[g_log.n] = bh->block_num;
+  g_log.hash[slot] = (uint16)(g_log.n + 1);
+  g_log.n++;
   release(&g_log.lock);
 }
 
-// 读取日志头并安装事务，确保幂等恢复
+// 校验从 data_pos 起的 n 个日志数据块与 rec_block 中的目标块号，返回 1 表示提交完整
+// 逐块直接读入暂存区计算 CRC，不占用缓存
+static int log_verify(uint32 data_pos, int n, uint32 seq, uint32 checksum) {
+  for (int i = 0; i < n; i++) {
+    if (log_read_slot(data_pos + (uint32)i, rec_data) < 0) return 0;
+    rec_crc[i] = crc32c(0, rec_data, BLOCK_SIZE);
+  }
+  return log_commit_checksum(seq, (uint32)n, rec_block, rec_crc) == checksum;
+}
+
+// 从超级块记录的尾部起依次重放序号连续、校验通过的提交记录，遇到第一个无效记录即停止
+// 重放完成后所有事务均已写回原位，循环区清空
 void recover_log(void) {
-  struct buffer_head *hdr = get_block(g_log.dev, (uint)g_log.start);
-  if (!hdr) {
-    printf("log: recover cannot read header\n");
+  struct buffer_head *sbh = get_block(g_log.dev, (uint)g_log.start);
+  if (!sbh) {
+    printf("log: recover cannot read log super block\n");
     return;
   }
-  struct log_header lh;
-  memset(&lh, 0, sizeof(lh));
-  memcpy(&lh, hdr->data, sizeof(lh));
-  put_block(hdr);
-
-  if (lh.n > 0 && lh.n <= LOG_MAX_BLOCKS && lh.n <= (uint32)(g_log.size - 1)) {
-    // 应用事务
-    for (uint32 i = 0; i < lh.n; i++) {
-      uint32 target_bno = lh.block[i];
-      uint32 log_bno = (uint32)(g_log.start + 1 + i);
-
-      struct buffer_head *logbh = get_block(g_log.dev, (uint)log_bno);
-      if (!logbh || !logbh->valid) { if (logbh) put_block(logbh); continue; }
-      struct buffer_head *dst = get_block(g_log.dev, (uint)target_bno);
-      if (!dst) { put_block(logbh); continue; }
+  struct log_super ls;
+  memcpy(&ls, sbh->data, sizeof(ls));
+  put_block(sbh);
 
-      memcpy(dst->data, logbh->data, BLOCK_SIZE);
-      dst->dirty = 1;
-      sync_block(dst);
+  if (ls.magic != LOG_SB_MAGIC || ls.tail >= (uint32)log_ring()) {
+    // 未格式化的日志区：初始化为空
+    g_log.head = g_log.tail = 0;
+    g_log.seq = 0;
+    g_log.tail_seq = 1;
+    write_log_super(0, 1);
+    return;
+  }
 
-      put_block(dst);
-      put_block(logbh);
+  uint32 t = ls.tail;
+  uint32 seq = ls.tail_seq;
+  int scanned = 0;
+  int replayed = 0;
+  while (scanned < log_ring()) {
+    uint32 checksum;
+    int n = read_record(t, seq, &checksum);
+    if (n < 0 || scanned + log_slots(n) > log_ring()) break;
+    uint32 data_pos = t + 1;
+    if (!log_verify(data_pos, n, seq, checksum)) {
+      // 提交记录不完整（崩溃发生在写出过程中）：丢弃
+      printf("log: discard incomplete commit seq=%d n=%d\n", seq, n);
+      break;
     }
-    // 清空日志头
-    clear_log_header();
+    // 应用事务
+    if (install_blocks(data_pos, rec_block, n) < 0) {
+      printf("log: recover install failed\n");
+      break;
+    }
+    t += (uint32)log_slots(n);
+    scanned += log_slots(n);
+    seq++;
+    replayed++;
   }
-}
+  if (replayed > 0) printf("log: recovered %d transactions\n", replayed);
 
+  // 推进尾指针：已重放的事务不会在下次启动时再次重放
+  t %= (uint32)log_ring();
+  write_log_super(t, seq);
+  g_log.head = g_log.tail = t;
+  g_log.tail_seq = seq;
+  g_log.seq = seq - 1;
+}
@@ -6,14 +6,64 @@
 #include "fs.h"
 #include "bcache.h"
 
-// 日志块上限（包含头部块之外的可记录数据块数量）
-// 受限于固定数组，需不超过日志区大小-1
-#define LOG_MAX_BLOCKS 64
+// 日志固定的缓存块上限：记录的块从写入事务起固定在缓存中，直到检查点写回原位
+// 未检查点事务与当前组的块数之和不超过该值，其余缓存留给普通读写
+#define LOG_PIN_MAX (BCACHE_NBUFS / 2)
+
+// 单个事务组可记录的数据块上限：组内的块须同时固定在缓存中，不超过 LOG_PIN_MAX
+// 实际上限还受日志区大小约束：提交记录与数据块需放入循环区
+// 该上限（32）低于固定缓存块之前的 64：记录的块在检查点前不可替换，组再大会占满块缓存。
+// 缺省的 LOG_SIZE 日志区每组本就只放得下 28 块，只有 mkfs 建立的大日志区受此约束
+#define LOG_MAX_BLOCKS LOG_PIN_MAX
+
+// 吸收（去重）用的开放寻址哈希表：槽数取不小于 LOG_MAX_BLOCKS 两倍的 2 的幂，装载率不超过一半
+#define LOG_HASH_BITS (LOG_MAX_BLOCKS <= 16 ? 5 : LOG_MAX_BLOCKS <= 32 ? 6 : LOG_MAX_BLOCKS <= 64 ? 7 : \
+                       LOG_MAX_BLOCKS <= 128 ? 8 : LOG_MAX_BLOCKS <= 256 ? 9 : LOG_MAX_BLOCKS <= 512 ? 10 : 11)
+#define LOG_HASH_SIZE (1 << LOG_HASH_BITS)
+
+// 恢复安装时每批处理的目标块数（同一批需同时持有目标块的引用）
+#define LOG_IO_BATCH 16
+
+// 单个事务默认预留的最大块数（begin_transaction 时一次性预留）
+#define LOG_OP_MAXBLOCKS 10
+
+// 组提交：事务结束后不立即提交，累积到日志接近满或等待超时后一次提交
+#define LOG_COMMIT_DELAY 2       // 首个块记入后最多等待的 tick 数
+#define LOG_GROUP_HIGH_PCT 75    // 已记录块数达到容量的该百分比时立即提交
+
+// 检查点：循环日志已用比例达到该百分比时唤醒检查点线程
+#define LOG_CKPT_HIGH_PCT 50
+
+// 日志区布局：起始块为日志超级块，其后 size-1 个块组成循环区
+// 每个已提交事务在循环区中占用连续的 1+n 个槽位：提交记录 + n 个数据块（可跨越回绕）
+// 提交把固定在缓存中的块冻结为副本后写入循环区；检查点线程稍后把副本写回原位并推进尾指针
+
+#define LOG_MAGIC    0x4c4f4743        // "LOGC"：提交记录
+#define LOG_SB_MAGIC 0x4c4f4753        // "LOGS"：日志超级块
+
+// 日志超级块：记录最老的未检查点事务位置，仅由检查点与恢复更新
+struct log_super {
+  uint32 magic;                  // LOG_SB_MAGIC，否则视为未格式化
+  uint32 tail;                   // 尾部事务在循环区中的槽位
+  uint32 tail_seq;               // 尾部事务的提交序号
+};
+
+// 提交记录：占循环区中事务的第一个槽位，之后为 n 个数据块
+// 记录与数据块在同一批写出；恢复时以序号和校验和判断提交是否完整
+#define LOG_HDR_NBLOCKS ((BLOCK_SIZE - 4 * sizeof(uint32)) / sizeof(uint32))
 
-// 日志头（存储在日志区起始块）
 struct log_header {
+  uint32 magic;                  // LOG_MAGIC
+  uint32 seq;                    // 提交序号，每次提交递增
   uint32 n;                      // 已记录的数据块数量
-  uint32 block[LOG_MAX_BLOCKS];  // 每个数据块对应的目标块号
+  uint32 checksum;               // CRC32C(seq, n, block[0..n), 各数据块的 CRC32C)
+  uint32 block[LOG_HDR_NBLOCKS]; // 各数据块对应的目标块号
+};
+
+// 单个事务的块数记账：事务在发起它的进程中执行，记在 struct proc 上
+struct log_tx {
+  int reserved;                  // begin_transaction_n 预留的块数，0 表示不在事务中
+  int nblocks;                   // 本事务新记入当前组的块数（已被组内吸收的块不计）
 };
 
 // 日志系统状态
@@ -22,18 +72,55 @@ struct log_state {
   int start;                     // 日志区起始块号
   int size;                      // 日志区大小（块数）
   int outstanding;               // 未完成的系统调用（事务）数量
+  int reserved;                  // 未完成事务预留的块数之和（outstanding 归零时清零）
   int committing;                // 是否正在提交
+  int checkpointing;             // 是否正在检查点
   int dev;                       // 设备号
 
   // 内部状态
   int n;                         // 当前记录的块数量
   uint32 block[LOG_MAX_BLOCKS];  // 记录的目标块号集合（去重）
+  struct buffer_head *buf[LOG_MAX_BLOCKS]; // 对应的固定缓存块
+  int npinned;                   // 已提交未检查点事务固定的块数
+  uint16 hash[LOG_HASH_SIZE];    // 块号 -> block[] 下标+1 的开放寻址哈希表，0 为空槽
+
+  // 循环区位置：单调递增的槽位计数，对循环区大小取模得到槽位
+  uint32 head;                   // 下一个事务的写入位置
+  uint32 tail;                   // 最老的未检查点事务位置
+  uint32 seq;                    // 最近一次提交的序号
+  uint32 tail_seq;               // 尾部事务的序号
+
+  // 组提交状态
+  uint64 group_start;            // 当前组首个块记入时的 tick
+  int ntrans;                    // 当前组已结束的事务数
 };
 
 void log_init(int dev, struct superblock *sb);
+// 单个事务组可容纳的数据块数，即单个事务预留的上限（log_init 之后有效）
+int log_capacity(void);
 void begin_transaction(void);
+// 开始事务并预留 maxblocks 个日志块；日志空间不足时睡眠等待提交或检查点释放空间
+void begin_transaction_n(int maxblocks);
 void end_transaction(void);
 void log_block_write(struct buffer_head *bh);
 void recover_log(void);
+// CRC32C（Castagnoli），crc 为前一段的结果，首段传 0
+uint32 crc32c(uint32 crc, const void *buf, uint32 len);
+// 计算提交记录校验和：blocks 为 n 个目标块号，bcrc[i] 为第 i 个日志数据块的 CRC32C
+uint32 log_commit_checksum(uint32 seq, uint32 n, const uint32 *blocks, const uint32 *bcrc);
+// 立即提交已累积的事务组（无未结束事务时），用于需要持久化保证的调用者
+void log_force(void);
+// 把所有已提交事务写回原位并推进尾指针
+void log_checkpoint(void);
+// 启动后台提交与检查点线程；未启动时退化为同步提交与同步检查点
+void log_commit_start(void);
+// 时钟中断上下文调用：组等待超时后唤醒提交线程
+void log_on_tick(void);
+
+// 统计计数器
+extern uint64 log_commits;        // 提交次数（每次一次记录写）
+extern uint64 log_group_trans;    // 被提交的事务总数（log_group_trans / log_commits 即平均组大小）
+extern uint64 log_checkpoints;    // 检查点次数（每次一次超级块写）
+extern uint64 log_ckpt_trans;     // 检查点写回的事务总数
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,331 @@
+#include "types.h"
+#include "string.h"
+#include "printf.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "pmm.h"
+#include "pagetable.h"
+#include "vm.h"
+#include "proc.h"
+#include "log.h"
+#include "inode.h"
+#include "pagecache.h"
+#include "file.h"
+#include "mmap.h"
+
+// 统计计数器
+uint64 mmap_faults = 0;
+uint64 mmap_copies = 0;
+uint64 mmap_reclaims = 0;
+
+// 缺页与解除映射只由拥有该窗口的进程执行，映射区的字段不需要加锁
+// 注意：缺页处理会取 ilock 并可能读盘，访问映射区时不可持有自旋锁
+//
+// 回写与回收需要找到映射某个缓存页的页表项：全部文件映射区串在 file_vmas 上，
+// mmap_lock 保护该链表以及文件页的页表项。不变式：共享映射的页表项可写时页一定是脏的——
+// 缺页在持锁时确认页仍脏才给写权限，回写在持锁时先撤销写权限再置干净
+// 回收会清除其他进程的页表项：缺页睡眠后须在持锁时确认页表项未变再修改
+static struct spinlock mmap_lock;
+static struct vma *file_vmas;
+
+void mmap_init(void) {
+  initlock(&mmap_lock, "mmap");
+  file_vmas = 0;
+}
+
+static struct vma *vma_find(struct proc *p, uint64 va) {
+  for (int i = 0; i < NVMA; i++) {
+    struct vma *v = &p->vmas[i];
+    if (v->used && va >= v->start && va < v->end) return v;
+  }
+  return 0;
+}
+
+// 在窗口内首次适配一段长度为 len 的空闲地址，没有返回 0
+static uint64 vma_place(struct proc *p, uint64 len) {
+  uint64 start = p->mmap_base;
+  int moved = 1;
+  while (moved) {
+    moved = 0;
+    for (int i = 0; i < NVMA; i++) {
+      struct vma *v = &p->vmas[i];
+      if (v->used && v->start < start + len && start < v->end) {
+        start = v->end;
+        moved = 1;
+      }
+    }
+  }
+  return start + len <= p->mmap_base + MMAP_WINDOW ? start : 0;
+}
+
+static uint32 vma_index(struct vma *v, uint64 va) {
+  return (uint32)((v->off + (va - v->start)) / PGSIZE);
+}
+
+// 释放映射持有的 inode 引用：最后一个引用可能截断已删除的文件，需在事务中
+static void vma_iput(struct minode *ip) {
+  begin_transaction_n(iput_opblocks(ip));
+  iput(ip);
+  end_transaction();
+}
+
+uint64 mmap(uint64 addr, uint64 len, int prot, int flags, int fd, uint32 off) {
+  (void)addr;
+  struct proc *p = get_current_process();
+  int share = flags & (MAP_SHARED | MAP_PRIVATE);
+  if (!p || len == 0 || len > MMAP_WINDOW || off % PGSIZE != 0) return MAP_FAILED;
+  if ((prot & ~(PROT_READ | PROT_WRITE)) || share == 0 || share == (MAP_SHARED | MAP_PRIVATE)) {
+    printf("mmap: bad prot %x / flags %x\n", prot, flags);
+    return MAP_FAILED;
+  }
+  len = PGROUNDUP(len);
+  struct vma *v = 0;
+  for (int i = 0; i < NVMA && !v; i++)
+    if (!p->vmas[i].used) v = &p->vmas[i];
+  uint64 start = vma_place(p, len);
+  if (!v || !start) {
+    printf("mmap: no free region for pid %d\n", p->pid);
+    return MAP_FAILED;
+  }
+  struct minode *ip = 0;
+  if (!(flags & MAP_ANONYMOUS)) {
+    // 共享的可写映射会写回文件，要求描述符可写
+    ip = fd_inode(fd, (flags & MAP_SHARED) && (prot & PROT_WRITE));
+    if (!ip) return MAP_FAILED;
+    if (imap_prepare(ip) < 0) {
+      vma_iput(ip);
+      return MAP_FAILED;
+    }
+  }
+  v->used = 1;
+  v->start = start;
+  v->end = start + len;
+  v->prot = prot;
+  v->flags = flags;
+  v->ip = ip;
+  v->off = off;
+  if (ip) {
+    acquire(&mmap_lock);
+    v->next = file_vmas;
+    file_vmas = v;
+    release(&mmap_lock);
+  }
+  return start;
+}
+
+// 清除 v 的页表项并释放各页：匿名页与写入时复制的页归还 pmm，文件页放回页缓存
+// 先从 file_vmas 摘下，回写与回收不再访问这些页表项；共享映射中可写的页必定是脏的，随后由 iflush 写出
+static void vma_unmap(struct vma *v) {
+  if (v->ip) {
+    acquire(&mmap_lock);
+    struct vma **pp = &file_vmas;
+    while (*pp != v) pp = &(*pp)->next;
+    *pp = v->next;
+    release(&mmap_lock);
+  }
+  for (uint64 va = v->start; va < v->end; va += PGSIZE) {
+    pte_t *pte = walk_lookup(kernel_pagetable, va);
+    if (!pte || !(*pte & PTE_V)) continue;
+    char *pa = (char*)PTE_PA(*pte);
+    int writable = (*pte & PTE_W) != 0;
+    *pte = 0;
+    if (!v->ip || (writable && !(v->flags & MAP_SHARED))) {
+      free_page(pa);
+      continue;
+    }
+    struct cpage *pg = pcache_lookup(v->ip, vma_index(v, va));
+    if (!pg || pg->data != pa) panic("munmap: mapped page not cached");
+    pcache_put(pg);
+    pcache_put(pg);   // 映射持有的引用
+  }
+  sfence_vma();
+  if (v->ip) {
+    if (v->flags & MAP_SHARED) iflush(v->ip);
+    vma_iput(v->ip);
+  }
+  memset(v, 0, sizeof(*v));
+}
+
+int munmap(uint64 addr, uint64 len) {
+  struct proc *p = get_current_process();
+  if (!p) return -1;
+  struct vma *v = vma_find(p, addr);
+  // 只支持解除整个映射区
+  if (!v || v->start != addr || v->end != addr + PGROUNDUP(len)) return -1;
+  vma_unmap(v);
+  return 0;
+}
+
+void mmap_exit(struct proc *p) {
+  for (int i = 0; i < NVMA; i++)
+    if (p->vmas[i].used) vma_unmap(&p->vmas[i]);
+}
+
+void mmap_mkclean(struct cpage *pg) {
+  int changed = 0;
+  uint64 off = (uint64)pg->index * PGSIZE;
+  acquire(&mmap_lock);
+  for (struct vma *v = file_vmas; v; v = v->next) {
+    if (v->ip != pg->ip || !(v->flags & MAP_SHARED) || !(v->prot & PROT_WRITE)) continue;
+    if (off < v->off || off - v->off >= v->end - v->start) continue;
+    pte_t *pte = walk_lookup(kernel_pagetable, v->start + (off - v->off));
+    if (pte && (*pte & PTE_V) && (*pte & PTE_W)) {
+      *pte &= ~PTE_W;
+      changed = 1;
+    }
+  }
+  pcache_mark_clean(pg);
+  release(&mmap_lock);
+  if (changed) sfence_vma();
+}
+
+// 把共享映射的页置脏，成功时持有 mmap_lock 返回，调用者在锁内给页表项写权限
+// 置脏与取锁之间回写可能已把页写出并置为干净，此时重新置脏
+static int dirty_locked(struct minode *ip, struct cpage *pg) {
+  for (;;) {
+    if (idirtypage(ip, pg) < 0) return -1;
+    acquire(&mmap_lock);
+    if (pg->dirty) return 0;
+    release(&mmap_lock);
+  }
+}
+
+// 页缓存耗尽时回收映射占用的页：清除页表项并放回映射持有的引用，返回回收的页数
+// 先回收只读映射的页，放回后干净的即可替换；没有时回收可写的共享页，它们必定是脏的，
+// 写回其中一个文件使这些页可替换。被回收的页再次访问时重新缺页
+static int mmap_reclaim(void) {
+  // 缺页可能发生在事务中（如 write 的源缓冲区是映射）：此时不能开始新事务，写回留给之后
+  struct proc *p = get_current_process();
+  int can_flush = !p || p->tx.reserved == 0;
+  struct minode *flush = 0;
+  int n = 0;
+  for (int pass = 0; pass < 2 && n == 0; pass++) {
+    acquire(&mmap_lock);
+    for (struct vma *v = file_vmas; v && n < MMAP_RECLAIM_BATCH; v = v->next) {
+      for (uint64 va = v->start; va < v->end && n < MMAP_RECLAIM_BATCH; va += PGSIZE) {
+        pte_t *pte = walk_lookup(kernel_pagetable, va);
+        if (!pte || !(*pte & PTE_V)) continue;
+        int writable = (*pte & PTE_W) != 0;
+        // 私有映射的可写页是复制出的匿名页，不在页缓存中
+        if (writable && (pass == 0 || !(v->flags & MAP_SHARED))) continue;
+        struct cpage *pg = pcache_lookup(v->ip, vma_index(v, va));
+        if (!pg || pg->data != (char*)PTE_PA(*pte)) panic("mmap_reclaim: mapped page not cached");
+        *pte = 0;
+        pcache_put(pg);
+        pcache_put(pg);   // 映射持有的引用
+        if (writable && !flush && can_flush) flush = idup(v->ip);
+        n++;
+      }
+    }
+    release(&mmap_lock);
+  }
+  if (n > 0) {
+    sfence_vma();
+    mmap_reclaims += (uint64)n;
+  }
+  if (flush) {
+    iflush(flush);
+    vma_iput(flush);
+  }
+  return n;
+}
+
+// 把文件页 pg 复制为私有的匿名页，内存不足返回 0
+static char *page_copy(struct cpage *pg) {
+  char *mem = alloc_page();
+  if (mem) {
+    memcpy(mem, pg->data, PGSIZE);
+    mmap_copies++;
+  }
+  return mem;
+}
+
+int mmap_fault(uint64 va, int write) {
+  struct proc *p = get_current_process();
+  struct vma *v = p ? vma_find(p, va) : 0;
+  if (!v || (write && !(v->prot & PROT_WRITE)) || v->prot == PROT_NONE) return -1;
+  va = PGROUNDDOWN(va);
+  mmap_faults++;
+  pte_t *pte = walk_lookup(kernel_pagetable, va);
+  if (pte && (*pte & PTE_V)) {
+    // 其他 hart 刚建立的页表项，本 hart 的 TLB 中还是旧的
+    if (!write || (*pte & PTE_W)) {
+      sfence_vma();
+      return 0;
+    }
+    // 对只读页的写：共享页置脏后改为可写，私有页复制
+    // 页表项已被回收清除时直接返回，访存重新缺页
+    acquire(&mmap_lock);
+    pte_t old = *pte;
+    struct cpage *pg = 0;
+    if (old & PTE_V) {
+      pg = pcache_lookup(v->ip, vma_index(v, va));
+      if (!pg || pg->data != (char*)PTE_PA(old)) panic("mmap_fault: mapped page not cached");
+    }
+    release(&mmap_lock);
+    if (!pg) return 0;
+    if (v->flags & MAP_SHARED) {
+      if (dirty_locked(v->ip, pg) < 0) {
+        pcache_put(pg);
+        return -1;
+      }
+      if (*pte == old) *pte |= PTE_W;
+      release(&mmap_lock);
+      pcache_put(pg);
+    } else {
+      char *mem = page_copy(pg);
+      if (!mem) {
+        pcache_put(pg);
+        return -1;
+      }
+      acquire(&mmap_lock);
+      int same = *pte == old;
+      if (same) *pte = PA_PTE((uint64)mem) | PTE_R | PTE_W | PTE_V;
+      release(&mmap_lock);
+      pcache_put(pg);
+      if (same) pcache_put(pg);   // 映射持有的引用
+      else free_page(mem);
+    }
+    sfence_vma();
+    return 0;
+  }
+
+  char *pa;
+  struct cpage *pg = 0;   // 直接映射的文件页，映射持有它的引用
+  int perm = PTE_R;
+  int locked = 0;         // 可写的共享页：持 mmap_lock 建立页表项
+  if (!v->ip) {
+    if (!(pa = alloc_page())) return -1;
+    memset(pa, 0, PGSIZE);
+    perm |= PTE_W;
+  } else {
+    // 文件末尾之外的页不存在；其余失败是页缓存被映射占满：回收后重试
+    uint32 index = vma_index(v, va);
+    while (!(pg = igetpage(v->ip, index)))
+      if ((uint64)index * PGSIZE >= v->ip->d.size || mmap_reclaim() == 0) return -1;
+    pa = pg->data;
+    if (write && (v->flags & MAP_SHARED)) {
+      if (dirty_locked(v->ip, pg) < 0) {
+        pcache_put(pg);
+        return -1;
+      }
+      locked = 1;
+      perm |= PTE_W;
+    } else if (write) {
+      pa = page_copy(pg);
+      pcache_put(pg);
+      pg = 0;
+      if (!pa) return -1;
+      perm |= PTE_W;
+    }
+  }
+  int r = map_page(kernel_pagetable, va, (uint64)pa, perm);
+  if (locked) release(&mmap_lock);
+  if (r < 0) {
+    if (pg) pcache_put(pg);
+    else free_page(pa);
+    return -1;
+  }
+  sfence_vma();
+  return 0;
+}
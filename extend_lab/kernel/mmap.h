@@ -0,0 +1,62 @@
+#ifndef MMAP_H
+#define MMAP_H
+
+#include "types.h"
+
+// 内存映射：把文件页或匿名页映射进虚拟地址空间，访问时缺页再建立页表项
+// 所有进程都是共享 kernel_pagetable 的内核线程，每个进程在 MMAP_BASE 之上独占一段窗口，
+// 映射区（VMA）记录在 struct proc 中；文件映射直接映射页缓存的物理页，不做复制
+#define MMAP_BASE   0x1000000000L   // 窗口区起点（64GB，高于物理内存的恒等映射）
+#define MMAP_WINDOW 0x40000000L     // 每个进程的窗口大小（1GB），按进程表下标排列
+#define NVMA 16                     // 每个进程的映射区数量
+#define MMAP_RECLAIM_BATCH 16       // 页缓存耗尽时一次回收的映射页数
+
+// [va, va+n) 是否触及映射窗口区：访问可能缺页，而缺页处理要取所映射文件的 ilock
+#define MMAP_RANGE(va, n) ((uint64)(va) + (uint64)(n) > MMAP_BASE)
+
+#define PROT_NONE  0x0
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+
+#define MAP_SHARED    0x1   // 写入经页缓存回到文件
+#define MAP_PRIVATE   0x2   // 写入时复制为匿名页，不影响文件
+#define MAP_ANONYMOUS 0x4   // 不对应文件，缺页时给清零页
+
+#define MAP_FAILED ((uint64)-1)
+
+struct minode;
+struct proc;
+struct cpage;
+
+struct vma {
+  int    used;
+  uint64 start;          // 页对齐，[start, end)
+  uint64 end;
+  int    prot;
+  int    flags;
+  struct minode *ip;     // 文件映射持有 inode 引用，匿名映射为 0
+  uint32 off;            // 文件内偏移（页对齐）
+  struct vma *next;      // 文件映射区链表（mmap_lock 保护）
+};
+
+void mmap_init(void);
+
+// 在当前进程的窗口中建立映射，addr 仅作提示（忽略），失败返回 MAP_FAILED
+uint64 mmap(uint64 addr, uint64 len, int prot, int flags, int fd, uint32 off);
+// 解除整个映射区（addr/len 须与 mmap 时一致），共享文件映射的脏页在此回写
+int munmap(uint64 addr, uint64 len);
+// 缺页处理：va 落在当前进程的映射区内且权限允许时建立页表项并返回 0，否则返回 -1
+// 页缓存被映射占满时先回收映射的页；仍失败（内存耗尽）同样返回 -1
+int mmap_fault(uint64 va, int write);
+// 进程退出时解除其全部映射
+void mmap_exit(struct proc *p);
+// 回写写出 pg 之前调用：撤销各共享映射对 pg 的写权限并把 pg 置为干净，
+// 之后经映射的写入重新缺页置脏，不会在回写后丢失
+void mmap_mkclean(struct cpage *pg);
+
+// 统计计数器
+extern uint64 mmap_faults;   // 经 mmap_fault 处理的缺页
+extern uint64 mmap_copies;   // 私有映射写入时复制的页
+extern uint64 mmap_reclaims; // 页缓存耗尽时回收的映射页
+
+#endif
@@ -0,0 +1,266 @@
+#include "types.h"
+#include "string.h"
+#include "printf.h"
+#include "spinlock.h"
+#include "pmm.h"
+#include "pagecache.h"
+
+static struct cpage ppool[PCACHE_NPAGES];
+static struct cpage plru;    // LRU 哑元头
+static struct spinlock pcache_lock;
+
+// 统计计数器
+uint64 pcache_hits = 0;
+uint64 pcache_misses = 0;
+uint64 pcache_evictions = 0;
+int pcache_ndirty = 0;
+int pcache_delayed = 0;
+
+static void plru_remove(struct cpage *pg) {
+  pg->lru_prev->lru_next = pg->lru_next;
+  pg->lru_next->lru_prev = pg->lru_prev;
+}
+
+static void plru_insert_mru(struct cpage *pg) {
+  pg->lru_next = plru.lru_next;
+  pg->lru_prev = &plru;
+  plru.lru_next->lru_prev = pg;
+  plru.lru_next = pg;
+}
+
+static void plru_insert_lru(struct cpage *pg) {
+  pg->lru_prev = plru.lru_prev;
+  pg->lru_next = &plru;
+  plru.lru_prev->lru_next = pg;
+  plru.lru_prev = pg;
+}
+
+// ===== 基数树（调用者持有 pcache_lock） =====
+// 高度为 h 的树覆盖页号 [0, 64^h)，叶层槽直接存放 struct cpage
+
+static int pc_fits(int height, uint32 index) {
+  return height >= 6 || (index >> (PCACHE_SHIFT * height)) == 0;
+}
+
+static uint pc_slot(uint32 index, int level) {
+  return (index >> (PCACHE_SHIFT * level)) & (PCACHE_FANOUT - 1);
+}
+
+static struct pc_node *pc_node_alloc(void) {
+  struct pc_node *n = (struct pc_node*)alloc_page();
+  if (n) memset(n, 0, sizeof(*n));
+  return n;
+}
+
+static struct cpage *tree_lookup(struct minode *ip, uint32 index) {
+  if (!ip->pc_root || !pc_fits(ip->pc_height, index)) return 0;
+  struct pc_node *n = ip->pc_root;
+  for (int level = ip->pc_height - 1; level > 0 && n; level--)
+    n = n->slot[pc_slot(index, level)];
+  return n ? n->slot[pc_slot(index, 0)] : 0;
+}
+
+// 插入 index -> pg：先加高树使其覆盖 index，再沿途补齐节点；内存不足返回 -1
+static int tree_insert(struct minode *ip, uint32 index, struct cpage *pg) {
+  if (!ip->pc_root) ip->pc_height = 1;
+  while (ip->pc_root && !pc_fits(ip->pc_height, index)) {
+    struct pc_node *top = pc_node_alloc();
+    if (!top) return -1;
+    top->slot[0] = ip->pc_root;
+    top->count = 1;
+    ip->pc_root = top;
+    ip->pc_height++;
+  }
+  while (!pc_fits(ip->pc_height, index)) ip->pc_height++;
+  if (!ip->pc_root && !(ip->pc_root = pc_node_alloc())) return -1;
+  struct pc_node *n = ip->pc_root;
+  for (int level = ip->pc_height - 1; level > 0; level--) {
+    uint s = pc_slot(index, level);
+    if (!n->slot[s]) {
+      struct pc_node *c = pc_node_alloc();
+      if (!c) return -1;
+      n->slot[s] = c;
+      n->count++;
+    }
+    n = n->slot[s];
+  }
+  n->slot[pc_slot(index, 0)] = pg;
+  n->count++;
+  return 0;
+}
+
+// 删除 index，沿途释放变空的节点
+static void tree_remove(struct minode *ip, uint32 index) {
+  struct pc_node *path[6];
+  struct pc_node *n = ip->pc_root;
+  int h = ip->pc_height;
+  if (!n || !pc_fits(h, index)) return;
+  for (int level = h - 1; level >= 0; level--) {
+    path[level] = n;
+    if (level > 0) {
+      n = n->slot[pc_slot(index, level)];
+      if (!n) return;
+    }
+  }
+  for (int level = 0; level < h; level++) {
+    struct pc_node *p = path[level];
+    uint s = pc_slot(index, level);
+    if (!p->slot[s]) return;
+    p->slot[s] = 0;
+    if (--p->count > 0) return;
+    free_page(p);
+    if (level == h - 1) {
+      ip->pc_root = 0;
+      ip->pc_height = 0;
+    }
+  }
+}
+
+// 解除 pg 与所属 inode 的关联，页本身留在池中（调用者持有 pcache_lock）
+static void page_detach(struct cpage *pg) {
+  tree_remove(pg->ip, pg->index);
+  pg->ip->pc_npages--;
+  if (pg->dirty) pg->ip->pc_ndirty--;
+  pg->ip = 0;
+  pg->valid = 0;
+  if (pg->dirty) pcache_ndirty--;
+  if (pg->delay) pcache_delayed--;
+  pg->dirty = 0;
+  pg->delay = 0;
+}
+
+void pcache_init(void) {
+  initlock(&pcache_lock, "pcache");
+  plru.lru_next = plru.lru_prev = &plru;
+  for (int i = 0; i < PCACHE_NPAGES; i++) {
+    struct cpage *pg = &ppool[i];
+    if (pg->ip) page_detach(pg);
+    if (pg->data) free_page(pg->data);
+    memset(pg, 0, sizeof(*pg));
+    plru_insert_lru(pg);
+  }
+  pcache_hits = 0;
+  pcache_misses = 0;
+  pcache_evictions = 0;
+  pcache_ndirty = 0;
+  pcache_delayed = 0;
+}
+
+struct cpage *pcache_get(struct minode *ip, uint32 index) {
+  acquire(&pcache_lock);
+  struct cpage *pg = tree_lookup(ip, index);
+  if (pg) {
+    pg->ref++;
+    plru_remove(pg);
+    plru_insert_mru(pg);
+    pcache_hits++;
+    release(&pcache_lock);
+    return pg;
+  }
+  pcache_misses++;
+  // 从 LRU 尾部找一个未被使用的干净页
+  for (pg = plru.lru_prev; pg != &plru && (pg->ref > 0 || pg->dirty); pg = pg->lru_prev)
+    ;
+  if (pg == &plru) {
+    release(&pcache_lock);
+    return 0;
+  }
+  if (pg->ip) {
+    page_detach(pg);
+    pcache_evictions++;
+  }
+  if (!pg->data) pg->data = alloc_page();
+  if (!pg->data || tree_insert(ip, index, pg) < 0) {
+    release(&pcache_lock);
+    printf("pcache: out of memory\n");
+    return 0;
+  }
+  pg->ip = ip;
+  pg->index = index;
+  pg->valid = 0;
+  pg->ref = 1;
+  ip->pc_npages++;
+  plru_remove(pg);
+  plru_insert_mru(pg);
+  release(&pcache_lock);
+  return pg;
+}
+
+struct cpage *pcache_lookup(struct minode *ip, uint32 index) {
+  acquire(&pcache_lock);
+  struct cpage *pg = tree_lookup(ip, index);
+  if (pg) pg->ref++;
+  release(&pcache_lock);
+  return pg;
+}
+
+void pcache_put(struct cpage *pg) {
+  acquire(&pcache_lock);
+  if (pg->ref <= 0) panic("pcache_put");
+  pg->ref--;
+  release(&pcache_lock);
+}
+
+void pcache_mark_dirty(struct cpage *pg, int delay) {
+  acquire(&pcache_lock);
+  if (!pg->dirty) {
+    pcache_ndirty++;
+    pg->ip->pc_ndirty++;
+  }
+  pg->dirty = 1;
+  if (delay && !pg->delay) {
+    pg->delay = 1;
+    pcache_delayed++;
+  }
+  release(&pcache_lock);
+}
+
+void pcache_mark_mapped(struct cpage *pg) {
+  acquire(&pcache_lock);
+  if (pg->delay) pcache_delayed--;
+  pg->delay = 0;
+  release(&pcache_lock);
+}
+
+void pcache_mark_clean(struct cpage *pg) {
+  acquire(&pcache_lock);
+  if (pg->delay) panic("pcache: clean unmapped page");
+  if (pg->dirty) {
+    pcache_ndirty--;
+    pg->ip->pc_ndirty--;
+  }
+  pg->dirty = 0;
+  release(&pcache_lock);
+}
+
+int pcache_dirty_pages(struct minode *ip, struct cpage **out, int max) {
+  int n = 0;
+  acquire(&pcache_lock);
+  for (int i = 0; i < PCACHE_NPAGES && n < max; i++) {
+    struct cpage *pg = &ppool[i];
+    if (pg->ip != ip || !pg->dirty) continue;
+    pg->ref++;
+    // 按页号插入排序
+    int j = n++;
+    while (j > 0 && out[j - 1]->index > pg->index) {
+      out[j] = out[j - 1];
+      j--;
+    }
+    out[j] = pg;
+  }
+  release(&pcache_lock);
+  return n;
+}
+
+void pcache_truncate(struct minode *ip, uint32 from) {
+  acquire(&pcache_lock);
+  for (int i = 0; i < PCACHE_NPAGES && ip->pc_npages > 0; i++) {
+    struct cpage *pg = &ppool[i];
+    if (pg->ip != ip || pg->index < from) continue;
+    if (pg->ref > 0) panic("pcache_truncate: page in use");
+    page_detach(pg);
+    plru_remove(pg);
+    plru_insert_lru(pg);
+  }
+  release(&pcache_lock);
+}
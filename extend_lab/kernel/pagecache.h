@@ -0,0 +1,61 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "types.h"
+#include "inode.h"
+
+// 文件页缓存：普通文件的数据按文件内页号缓存在 pmm 物理页中，每页对应文件的一个块
+// 每个内存 inode 一棵基数树（页号 -> 缓存页），节点也取自 pmm；全局固定数量的缓存页按 LRU 替换
+// 元数据仍走块缓存，大文件顺序读写不会挤出 inode、位图与目录块
+// 写入只弄脏页：空洞处的页不分配块（延迟分配），回写时整段分配连续的块并成批写出
+#define PCACHE_NPAGES  256   // 缓存页数量
+#define PCACHE_SHIFT   6
+#define PCACHE_FANOUT  (1 << PCACHE_SHIFT)   // 基数树每层的分支数
+#define PCACHE_BATCH   8     // 一次读入的最大页数
+#define PCACHE_WB_BATCH 32   // 回写一次派发的最大页数（与 BLK_MAX_SEGS 一致，合并为一个请求）
+#define PCACHE_DIRTY_HIGH (PCACHE_NPAGES / 2)   // 脏页超过该数时写入者先回写
+
+struct pc_node {
+  void *slot[PCACHE_FANOUT]; // 下层节点，或叶层的 struct cpage
+  int count;                 // 非空槽数
+};
+
+struct cpage {
+  struct minode *ip;         // 所属 inode，空闲页为 0
+  uint32 index;              // 文件内页号
+  int    ref;                // 使用中的引用，>0 时不可替换
+  int    valid;              // data 是否为文件当前内容
+  int    dirty;              // 内容比盘上新，回写前不可替换
+  int    delay;              // 脏页尚未分配块（延迟分配），计入 pcache_delayed
+  char  *data;               // pmm 物理页
+  struct cpage *lru_next;    // LRU 双向链：头部最近使用，尾部最先替换
+  struct cpage *lru_prev;
+};
+
+// 挂载时调用：释放全部缓存页与基数树节点（在 iinit 之前，需要旧 inode 的树根）
+void pcache_init(void);
+// 取得 ip 第 index 页（已引用，可能尚未 valid），缓存页全部在用或内存不足时返回 0
+// 调用者持有 ip 的 ilock，负责填充与使用页内容
+struct cpage *pcache_get(struct minode *ip, uint32 index);
+void pcache_put(struct cpage *pg);
+// 只查找不分配：ip 第 index 页在缓存中时返回（已引用），否则返回 0
+struct cpage *pcache_lookup(struct minode *ip, uint32 index);
+// 置脏；delay 为 1 表示该页还没有对应的块
+void pcache_mark_dirty(struct cpage *pg, int delay);
+// 回写为页分配了块
+void pcache_mark_mapped(struct cpage *pg);
+// 页已写到盘上
+void pcache_mark_clean(struct cpage *pg);
+// 按页号升序取得 ip 的脏页（均已引用），至多 max 个，返回个数
+int pcache_dirty_pages(struct minode *ip, struct cpage **out, int max);
+// 丢弃 ip 中页号 >= from 的缓存页，脏页一并丢弃（截断与 inode 回收时调用）
+void pcache_truncate(struct minode *ip, uint32 from);
+
+// 统计计数器
+extern uint64 pcache_hits;
+extern uint64 pcache_misses;
+extern uint64 pcache_evictions;
+extern int pcache_ndirty;      // 脏页数
+extern int pcache_delayed;     // 尚未分配块的脏页数：空闲块数需为其预留
+
+#endif
@@ -128,6 +128,10 @@ struct proc* alloc_process(void) {
   p->pagetable = 0;
   p->entry = 0;
   memset(p->name, 0, sizeof(p->name));
+  memset(p->vmas, 0, sizeof(p->vmas));
+  memset(p->ofile, 0, sizeof(p->ofile));
+  memset(&p->tx, 0, sizeof(p->tx));
+  p->mmap_base = MMAP_BASE + (uint64)(p - proctable) * MMAP_WINDOW;
 
   // 初始化调度属性
   p->priority = PRIORITY_DEFAULT;
@@ -179,13 +183,15 @@ void free_process(struct proc *p) {
   release(&p->lock);
 }
 
-int create_process_named(void (*entry)(void), const char *name) {
+static int spawn(void (*entry)(void), const char *name, int share_files) {
   struct proc *p = alloc_process();
   if (!p) return -1;
 
   acquire(&p->lock);
   p->entry = entry;
   p->parent = get_current_process();
+  // 在子进程可运行之前复制描述符
+  if (share_files && p->parent) files_inherit(p, p->parent);
   memset(&p->context, 0, sizeof(p->context));
   p->context.sp = (uint64)p->kstack + p->kstack_size;
   extern void kernel_thread_stub(void);
@@ -204,6 +210,14 @@ int create_process_named(void (*entry)(void), const char *name) {
   return pid;
 }
 
+int create_process_named(void (*entry)(void), const char *name) {
+  return spawn(entry, name, 0);
+}
+
+int create_process_shared(void (*entry)(void), const char *name) {
+  return spawn(entry, name, 1);
+}
+
 int create_process(void (*entry)(void)) {
   return create_process_named(entry, "kthread");
 }
@@ -211,6 +225,9 @@ int create_process(void (*entry)(void)) {
 void exit_process(int status) {
   struct proc *cur = get_current_process();
   if (!cur) return;
+  // 解除映射与关闭文件会回写文件页，需在关中断之前
+  mmap_exit(cur);
+  files_close(cur);
   int int_state = intr_get();
   intr_off();
   acquire(&cur->lock);
@@ -328,6 +345,9 @@ void sleep(void *chan, struct spinlock *lk) {
   // 保护状态与通道设置
   acquire(&p->lock);
   // 释放调用者锁，防止死锁；必须在持有 p->lock 的情况下释放以避免竞争
+  // 释放时保持中断关闭：否则持有 p->lock 期间可能被时钟中断重入（proc_on_tick 需取 p->lock）
+  int lk_state = lk->intr_state;
+  lk->intr_state = 0;
   release(lk);
   // 标记睡眠通道与状态
   p->chan = chan;
@@ -342,6 +362,8 @@ void sleep(void *chan, struct spinlock *lk) {
   p->chan = 0;
   // 唤醒后先重新获取调用者锁，再释放 p->lock
   acquire(lk);
+  // 调用者之后 release(lk) 时应恢复其 acquire 前的中断状态
+  lk->intr_state = lk_state;
   release(&p->lock);
   // 恢复进入时的中断状态
   intr_on(int_state);
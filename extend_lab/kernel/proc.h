@@ -4,6 +4,9 @@
 #include "types.h"
 #include "spinlock.h"
 #include "pagetable.h"
+#include "mmap.h"
+#include "file.h"
+#include "log.h"
 
 // 最大进程数（可根据内存调优）
 #define NPROC 64
@@ -82,6 +85,16 @@ struct proc {
   int wait_time;              // 等待时长（RUNNABLE 态累计，用于 aging）
   int slice_ticks;            // MLFQ：当前时间片内已用 tick 数
   int need_resched;           // 时间片用尽请求抢占（软抢占标志）
+
+  // ---- 内存映射（见 mmap.c）----
+  struct vma vmas[NVMA];      // 映射区，used 为 0 的是空槽
+  uint64 mmap_base;           // 本进程映射窗口的起点
+
+  // ---- 打开文件（见 file.c）----
+  struct file *ofile[NOFILE]; // 描述符表，fd 即下标
+
+  // ---- 日志事务（见 log.c）----
+  struct log_tx tx;           // 当前事务的预留与已记录块数
 };
 
 // 核心接口
@@ -89,6 +102,7 @@ struct proc* alloc_process(void);     // 分配进程结构
 void free_process(struct proc *p);    // 释放进程资源
 int create_process(void (*entry)(void)); // 创建新进程，返回 pid 或 <0
 int create_process_named(void (*entry)(void), const char *name); // 创建并命名
+int create_process_shared(void (*entry)(void), const char *name); // 同上，子进程继承父进程的描述符（同 fork）
 void exit_process(int status);        // 终止当前进程
 int wait_process(int *status);        // 等待子进程，返回子 pid 或 -1
 int waitpid(int pid, int *status);    // 等待特定子进程退出，返回 pid 或 -1
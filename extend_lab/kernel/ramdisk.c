@@ -0,0 +1,114 @@
+#include "types.h"
+#include "printf.h"
+#include "string.h"
+#include "pmm.h"
+#include "timer.h"
+#include "fs.h"
+#include "bcache.h"
+#include "ramdisk.h"
+
+struct ramdisk {
+  char *base;              // 块 0 的起始地址
+  uint32 nblocks;          // 容量（块数）
+  int owned;               // 内存是否由 ramdisk_init 分配
+  void *pages;             // alloc_pages 的返回值（释放时使用）
+  int npages;
+  uint64 lat_request;      // 每请求人工延迟（cycles）
+  uint64 lat_block;        // 每块人工延迟（cycles）
+};
+
+static struct ramdisk disks[RAMDISK_MAX_DEV];
+
+static struct ramdisk *rd_get(uint dev) {
+  if (dev >= RAMDISK_MAX_DEV || !disks[dev].base) return 0;
+  return &disks[dev];
+}
+
+int ramdisk_init(uint dev, uint32 nblocks) {
+  if (dev >= RAMDISK_MAX_DEV || nblocks == 0) return -1;
+  if (disks[dev].base) ramdisk_detach(dev);
+  // 新盘全为零：缓存中该设备号的旧块不能被当作它的内容
+  bcache_invalidate_dev(dev);
+  int npages = (int)(((uint64)nblocks * BLOCK_SIZE + PGSIZE - 1) / PGSIZE);
+  // alloc_pages 返回连续段的最高页，段向低地址延伸
+  void *pages = alloc_pages(npages);
+  if (!pages) {
+    printf("ramdisk: cannot allocate %d pages for dev %d\n", npages, dev);
+    return -1;
+  }
+  char *base = (char*)pages - (uint64)(npages - 1) * PGSIZE;
+  memset(base, 0, (size_t)npages * PGSIZE);
+  struct ramdisk *rd = &disks[dev];
+  memset(rd, 0, sizeof(*rd));
+  rd->base = base;
+  rd->nblocks = nblocks;
+  rd->owned = 1;
+  rd->pages = pages;
+  rd->npages = npages;
+  printf("ramdisk: dev=%d blocks=%d base=%p\n", dev, nblocks, base);
+  return 0;
+}
+
+int ramdisk_attach(uint dev, void *mem, uint32 nblocks) {
+  if (dev >= RAMDISK_MAX_DEV || !mem || nblocks == 0) return -1;
+  if (disks[dev].base) ramdisk_detach(dev);
+  bcache_invalidate_dev(dev);
+  struct ramdisk *rd = &disks[dev];
+  memset(rd, 0, sizeof(*rd));
+  rd->base = (char*)mem;
+  rd->nblocks = nblocks;
+  printf("ramdisk: dev=%d attached image blocks=%d base=%p\n", dev, nblocks, mem);
+  return 0;
+}
+
+void ramdisk_detach(uint dev) {
+  struct ramdisk *rd = rd_get(dev);
+  if (!rd) return;
+  // 盘还在时写回并丢弃它的缓存块
+  bcache_invalidate_dev(dev);
+  if (rd->owned) free_pages(rd->pages, rd->npages);
+  memset(rd, 0, sizeof(*rd));
+}
+
+void ramdisk_set_latency(uint dev, uint64 per_request, uint64 per_block) {
+  struct ramdisk *rd = rd_get(dev);
+  if (!rd) return;
+  rd->lat_request = per_request;
+  rd->lat_block = per_block;
+}
+
+int ramdisk_present(uint dev) {
+  return rd_get(dev) != 0;
+}
+
+uint32 ramdisk_nblocks(uint dev) {
+  struct ramdisk *rd = rd_get(dev);
+  return rd ? rd->nblocks : 0;
+}
+
+// 模拟设备耗时：忙等固定 cycles，使请求次数与传输量的差异可被测量
+// 驱动在 bcache_lock 下（关中断）被调用：忙等期间轮询时钟，到期的时钟中断不被推迟
+static void rd_delay(struct ramdisk *rd, uint32 n) {
+  uint64 cycles = rd->lat_request + rd->lat_block * n;
+  if (cycles == 0) return;
+  uint64 start = get_time();
+  while (get_time() - start < cycles) timer_poll();
+}
+
+int ramdisk_read(uint dev, uint32 block, uint32 n, char **bufs) {
+  struct ramdisk *rd = rd_get(dev);
+  if (!rd || block >= rd->nblocks || n > rd->nblocks - block) return -1;
+  rd_delay(rd, n);
+  for (uint32 i = 0; i < n; i++)
+    memcpy(bufs[i], rd->base + (uint64)(block + i) * BLOCK_SIZE, BLOCK_SIZE);
+  return 0;
+}
+
+int ramdisk_write(uint dev, uint32 block, uint32 n, char **bufs) {
+  struct ramdisk *rd = rd_get(dev);
+  if (!rd || block >= rd->nblocks || n > rd->nblocks - block) return -1;
+  rd_delay(rd, n);
+  for (uint32 i = 0; i < n; i++)
+    memcpy(rd->base + (uint64)(block + i) * BLOCK_SIZE, bufs[i], BLOCK_SIZE);
+  return 0;
+}
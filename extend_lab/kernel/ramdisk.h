@@ -0,0 +1,27 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include "types.h"
+
+// RAM 盘块设备：用连续物理页（或链接进内核的镜像）模拟磁盘
+// 用于在无 QEMU 磁盘模拟噪声的条件下测量缓存、合并与日志的收益
+
+#define RAMDISK_MAX_DEV 4       // 可挂载 RAM 盘的设备号范围 [0, RAMDISK_MAX_DEV)
+#define RAMDISK_DEV     1       // 基准测试默认使用的设备号
+
+// 在 dev 上创建 nblocks 块的 RAM 盘（alloc_pages 分配连续内存并清零），成功返回 0
+int ramdisk_init(uint dev, uint32 nblocks);
+// 把已有内存（如链接进内核的镜像）挂载为 dev 上的 RAM 盘
+int ramdisk_attach(uint dev, void *mem, uint32 nblocks);
+// 卸载 RAM 盘，若内存由 ramdisk_init 分配则归还
+void ramdisk_detach(uint dev);
+// 设置人工延迟（cycles）：每个请求固定开销 + 每块传输开销
+void ramdisk_set_latency(uint dev, uint64 per_request, uint64 per_block);
+
+int ramdisk_present(uint dev);
+uint32 ramdisk_nblocks(uint dev);
+// 驱动入口：一次传输 n 个连续块，bufs[i] 为第 i 块的缓冲
+int ramdisk_read(uint dev, uint32 block, uint32 n, char **bufs);
+int ramdisk_write(uint dev, uint32 block, uint32 n, char **bufs);
+
+#endif
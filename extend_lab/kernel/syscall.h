@@ -8,5 +8,9 @@
 #define SYS_exit         4
 #define SYS_write        5
 #define SYS_procdump     6
+#define SYS_mmap         7
+#define SYS_munmap       8
+#define SYS_sendfile     9
+#define SYS_copy_file_range 10
 
 #endif // SYSCALL_H
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 static uint64 tick_interval = 1000000ULL; // default 1M cycles
 static volatile uint64 g_ticks = 0;
+static volatile uint64 next_deadline = 0; // 已设定的下一次时钟中断时刻，0 表示时钟未启动
 
 __attribute__((weak)) void schedule_on_tick(void) {}
 
@@ -31,9 +32,17 @@ void timer_interrupt(void)
   g_ticks++;
   schedule_on_tick();
   uint64 next = get_time() + tick_interval;
+  next_deadline = next;
   sbi_set_timer(next);
 }
 
+void timer_poll(void)
+{
+  // 开中断时由真正的时钟中断处理；重新设定时钟同时清除挂起的中断
+  if(intr_get() || next_deadline == 0 || get_time() < next_deadline) return;
+  timer_interrupt();
+}
+
 void timer_init(uint64 interval_cycles)
 {
   if(interval_cycles) tick_interval = interval_cycles;
@@ -42,6 +51,7 @@ void timer_init(uint64 interval_cycles)
   uint64 next = now + tick_interval;
   printf("timer_init: interval=%p, now=%p, next=%p\n", tick_interval, now, next);
   // set first event and enable STIE
+  next_deadline = next;
   sbi_set_timer(next);
   enable_interrupt(5);
   printf("timer_init: STIE enabled, sie=%p, sstatus=%p\n", r_sie(), r_sstatus());
@@ -8,4 +8,6 @@ uint64 get_time(void);
 void timer_interrupt(void);
 void timer_init(uint64 interval_cycles);
 uint64 timer_ticks(void);
+// 关中断的长时间忙等中调用：时钟已到期时就地处理本次时钟中断
+void timer_poll(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,642 @@
+// mkfs：在宿主机上生成文件系统镜像，布局与内核的 fs_format 相同（见 kernel/fs.h）
+// 可选地把宿主目录的内容预先写入镜像，使基准测试从接近真实的文件系统直接开始
+//
+// 用法：mkfs [-b 块数] [-i inode 数] [-l 日志块数] [-d 宿主目录] 镜像文件
+//   -i 缺省时每 8 块一个 inode，且不少于宿主目录项数的两倍，并补满最后一个 inode 表块
+//   -l 缺省时取镜像块数的 1/512，介于 LOG_SIZE 与 MKFS_LOG_MAX 之间
+//
+// 分配全部顺序进行：inode 号从根目录（1）起递增，数据块从 data_start 起递增，
+// 因此两张位图都是前缀置位；文件数据连续存放并按 extent 映射，
+// 小文件与短符号链接内联，超过一块的目录建立散列索引
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static void die(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "mkfs: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  exit(1);
+}
+
+// ===== 宿主目录 =====
+// 放在包含 fs.h 之前：fs.h 的 struct dirent 与宿主 <dirent.h> 同名
+
+static int name_cmp(const void *a, const void *b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 读出目录 path 中除 "." 与 ".." 外的名字，按名字排序使镜像可重现，返回个数
+static int host_list(const char *path, char ***out) {
+  DIR *d = opendir(path);
+  if (!d) die("cannot open directory %s", path);
+  int n = 0, cap = 16;
+  char **names = malloc(cap * sizeof(char*));
+  struct dirent *e;
+  while ((e = readdir(d)) != 0) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    if (n == cap) names = realloc(names, (cap *= 2) * sizeof(char*));
+    names[n++] = strdup(e->d_name);
+  }
+  closedir(d);
+  qsort(names, n, sizeof(char*), name_cmp);
+  *out = names;
+  return n;
+}
+
+// fs.h 中内核的文件接口与目录项同宿主 libc 重名，包含时改名
+#define dirent          myfs_dirent
+#define open            myfs_open
+#define read            myfs_read
+#define write           myfs_write
+#define close           myfs_close
+#define unlink          myfs_unlink
+#define mkdir           myfs_mkdir
+#define symlink         myfs_symlink
+#define readlink        myfs_readlink
+#define sendfile        myfs_sendfile
+#define copy_file_range myfs_copy_file_range
+#include "fs.h"
+#undef open
+#undef read
+#undef write
+#undef close
+#undef unlink
+#undef mkdir
+#undef symlink
+#undef readlink
+#undef sendfile
+#undef copy_file_range
+
+// 事务组的大小受日志固定的缓存块数（LOG_PIN_MAX，数十块）限制，更大的日志区只能让
+// 更多已提交的组排队等待检查点；四个满组之后不再有收益
+#define MKFS_LOG_MAX 133
+
+static FILE *img;
+static struct superblock sb;
+static uint32 next_inum = 1;     // 下一个分配的 inode 号（0 保留）
+static uint32 next_block;        // 下一个分配的数据块
+static uint32 nfiles, ndirs, nsymlinks;
+
+static void wblock(uint32 bno, const void *buf) {
+  if (bno >= sb.fs_size_blocks) die("block %u out of range", bno);
+  if (pwrite(fileno(img), buf, BLOCK_SIZE, (off_t)bno * BLOCK_SIZE) != BLOCK_SIZE)
+    die("write block %u failed", bno);
+}
+
+static off_t inode_off(uint32 inum) {
+  return (off_t)MYFS_IBLOCK(&sb, inum) * BLOCK_SIZE + (off_t)(inum % MYFS_IPB) * sizeof(struct inode);
+}
+
+static void winode(uint32 inum, struct inode *ip) {
+  if (pwrite(fileno(img), ip, sizeof(*ip), inode_off(inum)) != sizeof(*ip))
+    die("write inode %u failed", inum);
+}
+
+static void rinode(uint32 inum, struct inode *ip) {
+  if (pread(fileno(img), ip, sizeof(*ip), inode_off(inum)) != sizeof(*ip))
+    die("read inode %u failed", inum);
+}
+
+static uint32 ialloc(void) {
+  if (next_inum >= sb.inode_count) die("out of inodes (%u), use a larger -i", sb.inode_count);
+  return next_inum++;
+}
+
+// 分配 n 个连续块，返回首块号
+static uint32 balloc(uint32 n) {
+  if (n > sb.fs_size_blocks - next_block)
+    die("out of blocks (%u), use a larger -b", sb.fs_size_blocks);
+  uint32 b = next_block;
+  next_block += n;
+  return b;
+}
+
+// 位图区 [start, start+size) 中置位前 n 位
+static void bitmap_prefix(uint32 start, uint32 size, uint32 n) {
+  uint8 buf[BLOCK_SIZE];
+  uint32 bits = BLOCK_SIZE * 8;
+  for (uint32 i = 0; i < size; i++) {
+    memset(buf, 0, sizeof(buf));
+    for (uint32 b = i * bits; b < n && b < (i + 1) * bits; b++)
+      buf[(b % bits) / 8] |= (uint8)(1 << (b % 8));
+    wblock(start + i, buf);
+  }
+}
+
+// ===== 文件 =====
+
+static void inode_init(struct inode *ip, int type, struct stat *st) {
+  memset(ip, 0, sizeof(*ip));
+  ip->mode = MYFS_MODE(type, st->st_mode & 0777);
+  ip->nlink = 1;
+  ip->atime = (uint32)st->st_atime;
+  ip->mtime = (uint32)st->st_mtime;
+  ip->ctime = (uint32)st->st_ctime;
+}
+
+// 初始化空的 extent 树根（同内核 ext_init）
+static struct myfs_extent_header *ext_init(struct inode *ip) {
+  memset(ip->i_block, 0, sizeof(ip->i_block));
+  struct myfs_extent_header *h = (struct myfs_extent_header*)ip->i_block;
+  h->magic = MYFS_EXT_MAGIC;
+  h->max = (uint16)MYFS_EXT_INODE_MAX;
+  ip->flags |= MYFS_FL_EXTENTS;
+  return h;
+}
+
+// 把连续的 n 块 [first, first+n) 映射为逻辑块 0..n-1；根放不下时建一层叶块（depth 1）
+static void ext_map_run(struct inode *ip, uint32 first, uint32 n) {
+  struct myfs_extent_header *h = ext_init(ip);
+  struct myfs_extent *root = (struct myfs_extent*)(h + 1);
+  uint32 next = (n + MYFS_EXT_MAX_LEN - 1) / MYFS_EXT_MAX_LEN;
+  ip->blocks = n;
+  if (next <= MYFS_EXT_INODE_MAX) {
+    for (uint32 i = 0; i < next; i++) {
+      uint32 lblk = i * MYFS_EXT_MAX_LEN;
+      root[i].lblk = lblk;
+      root[i].pblk = first + lblk;
+      root[i].len = n - lblk < MYFS_EXT_MAX_LEN ? n - lblk : MYFS_EXT_MAX_LEN;
+    }
+    h->entries = (uint16)next;
+    return;
+  }
+  uint32 nleaves = (next + MYFS_EXT_LEAF_MAX - 1) / MYFS_EXT_LEAF_MAX;
+  if (nleaves > MYFS_EXT_INODE_MAX) die("file of %u blocks needs too many extents", n);
+  uint32 leaf = balloc(nleaves);
+  ip->blocks += nleaves;
+  h->depth = 1;
+  h->entries = (uint16)nleaves;
+  for (uint32 l = 0; l < nleaves; l++) {
+    uint8 buf[BLOCK_SIZE];
+    memset(buf, 0, sizeof(buf));
+    struct myfs_extent_header *lh = (struct myfs_extent_header*)buf;
+    struct myfs_extent *e = (struct myfs_extent*)(lh + 1);
+    lh->magic = MYFS_EXT_MAGIC;
+    lh->max = (uint16)MYFS_EXT_LEAF_MAX;
+    for (uint32 i = l * MYFS_EXT_LEAF_MAX; i < next && i < (l + 1) * MYFS_EXT_LEAF_MAX; i++) {
+      uint32 lblk = i * MYFS_EXT_MAX_LEN;
+      e[lh->entries].lblk = lblk;
+      e[lh->entries].pblk = first + lblk;
+      e[lh->entries].len = n - lblk < MYFS_EXT_MAX_LEN ? n - lblk : MYFS_EXT_MAX_LEN;
+      lh->entries++;
+    }
+    root[l].lblk = e[0].lblk;
+    root[l].pblk = leaf + l;
+    root[l].len = 0;
+    wblock(leaf + l, buf);
+  }
+}
+
+// 同一宿主文件的多个硬链接共用一个 inode
+struct hardlink {
+  dev_t  dev;
+  ino_t  ino;
+  uint32 inum;
+};
+static struct hardlink *links;
+static int nlinks, links_cap;
+
+static uint32 add_file(const char *path, struct stat *st) {
+  if (st->st_nlink > 1) {
+    for (int i = 0; i < nlinks; i++) {
+      if (links[i].dev == st->st_dev && links[i].ino == st->st_ino) {
+        struct inode di;
+        rinode(links[i].inum, &di);
+        di.nlink++;
+        winode(links[i].inum, &di);
+        return links[i].inum;
+      }
+    }
+  }
+  if ((uint64)st->st_size > 0xFFFFFFFFULL || (uint64)st->st_size > MYFS_MAX_FILE_SIZE)
+    die("%s: too large", path);
+  uint32 inum = ialloc();
+  struct inode di;
+  inode_init(&di, MYFT_REG, st);
+  di.size = (uint32)st->st_size;
+  FILE *f = fopen(path, "rb");
+  if (!f) die("cannot open %s", path);
+  if (di.size <= MYFS_INLINE_MAX) {
+    // 与内核新建的普通文件相同：extent 树根为空，数据内联
+    ext_init(&di);
+    di.flags |= MYFS_FL_INLINE;
+    if (fread(di.inline_data, 1, di.size, f) != di.size) die("short read on %s", path);
+  } else {
+    uint32 n = (di.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32 first = balloc(n);
+    uint8 buf[BLOCK_SIZE];
+    for (uint32 i = 0; i < n; i++) {
+      uint32 want = di.size - i * BLOCK_SIZE < BLOCK_SIZE ? di.size - i * BLOCK_SIZE : BLOCK_SIZE;
+      memset(buf, 0, sizeof(buf));
+      if (fread(buf, 1, want, f) != want) die("short read on %s", path);
+      wblock(first + i, buf);
+    }
+    ext_map_run(&di, first, n);
+  }
+  fclose(f);
+  winode(inum, &di);
+  nfiles++;
+  if (st->st_nlink > 1) {
+    if (nlinks == links_cap) links = realloc(links, (links_cap = links_cap ? links_cap * 2 : 16) * sizeof(*links));
+    links[nlinks].dev = st->st_dev;
+    links[nlinks].ino = st->st_ino;
+    links[nlinks].inum = inum;
+    nlinks++;
+  }
+  return inum;
+}
+
+// 符号链接目标不含终止符，size 为其长度；过长的目标跳过并返回 0
+static uint32 add_symlink(const char *path, struct stat *st) {
+  char target[MYFS_SYMLINK_MAX + 1];
+  ssize_t len = readlink(path, target, sizeof(target));
+  if (len < 0) die("cannot read link %s", path);
+  if (len > MYFS_SYMLINK_MAX) {
+    fprintf(stderr, "mkfs: %s: link target too long, skipped\n", path);
+    return 0;
+  }
+  uint32 inum = ialloc();
+  struct inode di;
+  inode_init(&di, MYFT_SYMLINK, st);
+  di.size = (uint32)len;
+  if (len <= MYFS_INLINE_MAX) {
+    ext_init(&di);
+    di.flags |= MYFS_FL_INLINE;
+    memcpy(di.inline_data, target, len);
+  } else {
+    uint8 buf[BLOCK_SIZE];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, target, len);
+    uint32 b = balloc(1);
+    wblock(b, buf);
+    ext_map_run(&di, b, 1);
+  }
+  winode(inum, &di);
+  nsymlinks++;
+  return inum;
+}
+
+// ===== 目录 =====
+
+struct ent {
+  char  *name;
+  uint   len;
+  uint32 ino;
+  uint8  type;
+  uint32 hash;
+};
+
+static uint32 dx_hash(const char *name, uint len) {
+  uint32 h = 2166136261u;   // FNV-1a，与内核 dir.c 相同
+  for (uint i = 0; i < len; i++) {
+    h ^= (uint8)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int ent_cmp(const void *a, const void *b) {
+  const struct ent *x = a, *y = b;
+  if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+// 在 buf 的 *off 处追加一项（rec_len 取最小长度），返回该项
+static struct myfs_dirent *dirent_put(uint8 *buf, uint *off, const char *name, uint len, uint32 ino, uint8 type) {
+  struct myfs_dirent *de = (struct myfs_dirent*)(buf + *off);
+  de->ino = ino;
+  de->rec_len = (uint16)MYFS_DIRENT_LEN(len);
+  de->name_len = (uint8)len;
+  de->type = type;
+  memcpy(de->name, name, len);
+  *off += de->rec_len;
+  return de;
+}
+
+// 块内最后一项覆盖其余空间；空块为一个 ino 为 0 的整块空闲项
+static void block_finish(uint8 *buf, struct myfs_dirent *last, uint off) {
+  if (!last) {
+    last = (struct myfs_dirent*)buf;
+    last->ino = 0;
+    off = BLOCK_SIZE;
+  }
+  last->rec_len = (uint16)(last->rec_len + BLOCK_SIZE - off);
+}
+
+// 把连续的 n 块映射为目录的逻辑块 0..n-1（目录仍用直接块与间接块）
+static void map_blocks(struct inode *ip, uint32 first, uint32 n) {
+  uint32 ptrs[MYFS_PTRS_PER_BLOCK];
+  ip->blocks = n;
+  for (uint32 i = 0; i < n && i < MYFS_NDIRECT; i++) ip->direct[i] = first + i;
+  if (n <= MYFS_NDIRECT) return;
+  uint32 lblk = MYFS_NDIRECT;
+  ip->indirect = balloc(1);
+  ip->blocks++;
+  memset(ptrs, 0, sizeof(ptrs));
+  for (uint32 i = 0; i < MYFS_PTRS_PER_BLOCK && lblk < n; i++) ptrs[i] = first + lblk++;
+  wblock(ip->indirect, ptrs);
+  if (lblk == n) return;
+  uint32 dptrs[MYFS_PTRS_PER_BLOCK];
+  memset(dptrs, 0, sizeof(dptrs));
+  ip->double_indirect = balloc(1);
+  ip->blocks++;
+  for (uint32 j = 0; j < MYFS_PTRS_PER_BLOCK && lblk < n; j++) {
+    dptrs[j] = balloc(1);
+    ip->blocks++;
+    memset(ptrs, 0, sizeof(ptrs));
+    for (uint32 i = 0; i < MYFS_PTRS_PER_BLOCK && lblk < n; i++) ptrs[i] = first + lblk++;
+    wblock(dptrs[j], ptrs);
+  }
+  if (lblk < n) die("directory of %u blocks too large", n);
+  wblock(ip->double_indirect, dptrs);
+}
+
+// 写出目录 inum 的数据块与 inode：放得进一块时为线性目录，否则建立散列索引
+// 索引目录的叶块按散列值排满，只在散列值变化处换块，查找只需访问一个叶块
+static void write_dir(uint32 inum, uint32 parent, struct ent *ents, int n, int nsub, struct stat *st) {
+  struct inode di;
+  inode_init(&di, MYFT_DIR, st);
+  di.nlink = (uint16)(2 + nsub);
+  uint8 buf[BLOCK_SIZE];
+  uint need = MYFS_DIRENT_LEN(1) + MYFS_DIRENT_LEN(2);
+  for (int i = 0; i < n; i++) need += MYFS_DIRENT_LEN(ents[i].len);
+
+  if (need <= BLOCK_SIZE) {
+    memset(buf, 0, sizeof(buf));
+    uint off = 0;
+    struct myfs_dirent *last;
+    dirent_put(buf, &off, ".", 1, inum, MYFT_DIR);
+    last = dirent_put(buf, &off, "..", 2, parent, MYFT_DIR);
+    for (int i = 0; i < n; i++) last = dirent_put(buf, &off, ents[i].name, ents[i].len, ents[i].ino, ents[i].type);
+    block_finish(buf, last, off);
+    uint32 b = balloc(1);
+    wblock(b, buf);
+    map_blocks(&di, b, 1);
+    di.size = BLOCK_SIZE;
+    winode(inum, &di);
+    return;
+  }
+
+  // 按散列值排序并划分叶块：leaf_first[k] 为第 k 个叶块的首项
+  for (int i = 0; i < n; i++) ents[i].hash = dx_hash(ents[i].name, ents[i].len);
+  qsort(ents, n, sizeof(*ents), ent_cmp);
+  int *leaf_first = malloc((n + 1) * sizeof(int));
+  int nleaves = 0;
+  uint used = BLOCK_SIZE;
+  for (int i = 0; i < n; ) {
+    int j = i;
+    uint run = 0;
+    while (j < n && ents[j].hash == ents[i].hash) run += MYFS_DIRENT_LEN(ents[j++].len);
+    if (run > BLOCK_SIZE) die("too many names with hash %x", ents[i].hash);
+    if (used + run > BLOCK_SIZE) {
+      leaf_first[nleaves++] = i;
+      used = 0;
+    }
+    used += run;
+    i = j;
+  }
+  leaf_first[nleaves] = n;
+  // 叶块太多时根下加一层索引块（levels 1）
+  int levels = nleaves > (int)MYFS_DX_ROOT_LIMIT;
+  int nnodes = levels ? (nleaves + MYFS_DX_NODE_LIMIT - 1) / MYFS_DX_NODE_LIMIT : 0;
+  if (nnodes > (int)MYFS_DX_ROOT_LIMIT) die("directory with %d names too large", n);
+  uint32 nblocks = 1 + nnodes + nleaves;
+  uint32 first = balloc(nblocks);
+  uint32 leaf0 = 1 + nnodes;   // 首个叶块的逻辑块号
+
+  // 块 0："." 与覆盖其余空间的 ".."，索引根位于 MYFS_DX_ROOT_OFF
+  memset(buf, 0, sizeof(buf));
+  uint off = 0;
+  dirent_put(buf, &off, ".", 1, inum, MYFT_DIR);
+  struct myfs_dirent *last = dirent_put(buf, &off, "..", 2, parent, MYFT_DIR);
+  block_finish(buf, last, off);
+  struct myfs_dx_header *h = (struct myfs_dx_header*)(buf + MYFS_DX_ROOT_OFF);
+  struct myfs_dx_entry *e = (struct myfs_dx_entry*)(h + 1);
+  h->magic = MYFS_DX_MAGIC;
+  h->limit = (uint16)MYFS_DX_ROOT_LIMIT;
+  h->levels = (uint8)levels;
+  if (!levels) {
+    for (int k = 0; k < nleaves; k++) {
+      e[k].hash = k ? ents[leaf_first[k]].hash : 0;
+      e[k].block = leaf0 + k;
+    }
+    h->count = (uint16)nleaves;
+  } else {
+    for (int j = 0; j < nnodes; j++) {
+      e[j].hash = j ? ents[leaf_first[j * MYFS_DX_NODE_LIMIT]].hash : 0;
+      e[j].block = 1 + j;
+    }
+    h->count = (uint16)nnodes;
+  }
+  wblock(first, buf);
+
+  // 索引块：以覆盖整块的空闲项开头，使线性扫描跳过
+  for (int j = 0; j < nnodes; j++) {
+    memset(buf, 0, sizeof(buf));
+    block_finish(buf, 0, 0);
+    h = (struct myfs_dx_header*)(buf + MYFS_DX_NODE_OFF);
+    e = (struct myfs_dx_entry*)(h + 1);
+    h->magic = MYFS_DX_MAGIC;
+    h->limit = (uint16)MYFS_DX_NODE_LIMIT;
+    for (int k = j * MYFS_DX_NODE_LIMIT; k < nleaves && k < (j + 1) * (int)MYFS_DX_NODE_LIMIT; k++) {
+      e[h->count].hash = k ? ents[leaf_first[k]].hash : 0;
+      e[h->count].block = leaf0 + k;
+      h->count++;
+    }
+    wblock(first + 1 + j, buf);
+  }
+
+  for (int k = 0; k < nleaves; k++) {
+    memset(buf, 0, sizeof(buf));
+    off = 0;
+    last = 0;
+    for (int i = leaf_first[k]; i < leaf_first[k + 1]; i++)
+      last = dirent_put(buf, &off, ents[i].name, ents[i].len, ents[i].ino, ents[i].type);
+    block_finish(buf, last, off);
+    wblock(first + leaf0 + k, buf);
+  }
+  free(leaf_first);
+
+  map_blocks(&di, first, nblocks);
+  di.size = nblocks * BLOCK_SIZE;
+  di.flags |= MYFS_FL_INDEX;
+  winode(inum, &di);
+}
+
+// 递归复制宿主目录 path；parent 为 0 时是根目录，".." 指向自身
+static uint32 add_dir(const char *path, uint32 parent, struct stat *st) {
+  uint32 inum = ialloc();
+  if (!parent) parent = inum;
+  char **names;
+  int n = host_list(path, &names);
+  struct ent *ents = malloc((n + 1) * sizeof(*ents));
+  int m = 0, nsub = 0;
+  for (int i = 0; i < n; i++) {
+    uint len = strlen(names[i]);
+    char *child = malloc(strlen(path) + len + 2);
+    sprintf(child, "%s/%s", path, names[i]);
+    struct stat cst;
+    if (lstat(child, &cst) < 0) die("cannot stat %s", child);
+    uint32 ino = 0;
+    uint8 type = MYFT_UNKNOWN;
+    if (len > 255) {
+      fprintf(stderr, "mkfs: %s: name too long, skipped\n", child);
+    } else if (S_ISDIR(cst.st_mode)) {
+      ino = add_dir(child, inum, &cst);
+      type = MYFT_DIR;
+      nsub++;
+    } else if (S_ISREG(cst.st_mode)) {
+      ino = add_file(child, &cst);
+      type = MYFT_REG;
+    } else if (S_ISLNK(cst.st_mode)) {
+      ino = add_symlink(child, &cst);
+      type = MYFT_SYMLINK;
+    } else {
+      fprintf(stderr, "mkfs: %s: unsupported file type, skipped\n", child);
+    }
+    free(child);
+    if (ino) {
+      ents[m].name = names[i];
+      ents[m].len = len;
+      ents[m].ino = ino;
+      ents[m].type = type;
+      m++;
+    }
+  }
+  write_dir(inum, parent, ents, m, nsub, st);
+  for (int i = 0; i < n; i++) free(names[i]);
+  free(names);
+  free(ents);
+  ndirs++;
+  return inum;
+}
+
+// 宿主目录树中的目录项数（估算 inode 数用）
+static uint32 host_count(const char *path) {
+  char **names;
+  int n = host_list(path, &names);
+  uint32 total = (uint32)n;
+  for (int i = 0; i < n; i++) {
+    char *child = malloc(strlen(path) + strlen(names[i]) + 2);
+    sprintf(child, "%s/%s", path, names[i]);
+    struct stat cst;
+    if (lstat(child, &cst) == 0 && S_ISDIR(cst.st_mode)) total += host_count(child);
+    free(child);
+    free(names[i]);
+  }
+  free(names);
+  return total;
+}
+
+static uint32 parse_num(const char *s, char opt) {
+  char *end;
+  unsigned long v = strtoul(s, &end, 0);
+  if (*s == '\0' || *end != '\0' || v > 0xFFFFFFFFUL) die("bad value for -%c: %s", opt, s);
+  return (uint32)v;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: mkfs [-b blocks] [-i inodes] [-l logblocks] [-d hostdir] image\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  uint32 nblocks = 4096, ninodes = 0, logsize = 0;
+  const char *root = 0;
+  int c;
+  while ((c = getopt(argc, argv, "b:i:l:d:")) != -1) {
+    switch (c) {
+    case 'b': nblocks = parse_num(optarg, 'b'); break;
+    case 'i': ninodes = parse_num(optarg, 'i'); break;
+    case 'l': logsize = parse_num(optarg, 'l'); break;
+    case 'd': root = optarg; break;
+    default: usage();
+    }
+  }
+  if (optind != argc - 1) usage();
+  const char *out = argv[optind];
+
+  uint32 bits = BLOCK_SIZE * 8;
+  uint32 nnames = 0;
+  struct stat rst;
+  if (root) {
+    if (stat(root, &rst) < 0 || !S_ISDIR(rst.st_mode)) die("%s is not a directory", root);
+    nnames = host_count(root);
+  } else {
+    memset(&rst, 0, sizeof(rst));
+    rst.st_mode = 0755;
+  }
+  if (nblocks > FS_MAX_GROUPS * bits) die("at most %u blocks", FS_MAX_GROUPS * bits);
+  if (ninodes == 0) {
+    // 留出运行时新建文件的余量，补满最后一个 inode 表块
+    ninodes = nblocks / 8;
+    if (ninodes < 2 * nnames + 16) ninodes = 2 * nnames + 16;
+    ninodes = (ninodes + MYFS_IPB - 1) / MYFS_IPB * MYFS_IPB;
+    if (ninodes > FS_MAX_GROUPS * bits) ninodes = FS_MAX_GROUPS * bits;
+  }
+  if (ninodes < nnames + 2) die("%u inodes cannot hold %u names", ninodes, nnames);
+  if (ninodes > FS_MAX_GROUPS * bits) die("at most %u inodes", FS_MAX_GROUPS * bits);
+  if (logsize == 0) {
+    logsize = nblocks / 512;
+    if (logsize < LOG_SIZE) logsize = LOG_SIZE;
+    if (logsize > MKFS_LOG_MAX) logsize = MKFS_LOG_MAX;
+  }
+  if (logsize < LOG_SIZE) die("log must be at least %d blocks", LOG_SIZE);
+
+  // 布局与 fs_format 相同，只是日志区大小可调
+  sb.magic = MYFS_MAGIC;
+  sb.version = MYFS_VERSION;
+  sb.block_size = BLOCK_SIZE;
+  sb.fs_size_blocks = nblocks;
+  sb.inode_count = ninodes;
+  sb.log_start = LOG_START;
+  sb.log_size = logsize;
+  sb.inode_bitmap_start = LOG_START + logsize;
+  sb.inode_bitmap_size = (ninodes + bits - 1) / bits;
+  sb.block_bitmap_start = sb.inode_bitmap_start + sb.inode_bitmap_size;
+  sb.block_bitmap_size = (nblocks + bits - 1) / bits;
+  sb.inode_table_start = sb.block_bitmap_start + sb.block_bitmap_size;
+  sb.inode_table_size = (ninodes + MYFS_IPB - 1) / MYFS_IPB;
+  sb.data_start = sb.inode_table_start + sb.inode_table_size;
+  sb.root_inode = 1;
+  if ((uint64)sb.data_start + 1 >= nblocks)
+    die("%u blocks too small for %u inodes and a %u-block log", nblocks, ninodes, logsize);
+  next_block = sb.data_start;
+
+  // 新建并截断到全盘大小：日志区、位图与 inode 表初始为零（全零的日志区视为空日志）
+  if (!(img = fopen(out, "w+b"))) die("cannot create %s", out);
+  if (ftruncate(fileno(img), (off_t)nblocks * BLOCK_SIZE) < 0) die("cannot size %s", out);
+
+  if (root) {
+    add_dir(root, 0, &rst);
+  } else {
+    ialloc();
+    write_dir(sb.root_inode, sb.root_inode, 0, 0, 0, &rst);
+    ndirs++;
+  }
+
+  // 顺序分配：元数据区与已写入的数据块、inode 0 至最后分配的 inode 均为已用
+  bitmap_prefix(sb.block_bitmap_start, sb.block_bitmap_size, next_block);
+  bitmap_prefix(sb.inode_bitmap_start, sb.inode_bitmap_size, next_inum);
+  sb.free_block_count = nblocks - next_block;
+  sb.free_inode_count = ninodes - next_inum;
+  uint8 buf[BLOCK_SIZE];
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, &sb, sizeof(sb));
+  wblock(SUPERBLOCK_NUM, buf);
+  if (fclose(img) != 0) die("cannot write %s", out);
+
+  printf("mkfs: %s blocks=%u inodes=%u log=%u data_start=%u\n", out, nblocks, ninodes, logsize, sb.data_start);
+  printf("mkfs: %u files, %u dirs, %u symlinks, %u blocks and %u inodes free\n",
+         nfiles, ndirs, nsymlinks, sb.free_block_count, sb.free_inode_count);
+  return 0;
+}